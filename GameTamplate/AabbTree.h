@@ -0,0 +1,618 @@
+#pragma once
+#include "GameObject.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+// Dynamic bounding volume tree over GameObjects, for picking and for
+// point, box and ray queries that only visit the branches they can hit.
+//
+// Leaves hold a fattened box: the object's box, plus the box it moved from
+// this step, grown by a margin and by where its velocity will take it
+// shortly. As long as the object stays inside that box, moving it costs
+// nothing; once it leaves, its leaf is taken out and reinserted. Inserting picks the sibling that grows the
+// tree's total perimeter least, and every node on the way back up is
+// rebalanced with a rotation if one child is more than one level taller
+// than the other, so the height stays logarithmic.
+class AabbTree {
+public:
+	typedef std::int32_t proxy;
+	static const proxy null_proxy = -1;
+
+	struct ray_hit {
+		GameObject* object;
+		// Along the normalized direction, from the ray origin
+		float distance;
+	};
+
+private:
+	struct node {
+		// Fattened for leaves, the union of the children otherwise
+		glm::vec2 min;
+		glm::vec2 max;
+
+		// Leaves only: the object's box, which queries test against, and
+		// that box joined with where it was before this step's displacement
+		glm::vec2 tight_min;
+		glm::vec2 tight_max;
+		glm::vec2 swept_min;
+		glm::vec2 swept_max;
+		GameObject* object;
+
+		// Next free node while the node is unused
+		proxy parent;
+		proxy child1;
+		proxy child2;
+
+		// 0 for leaves, -1 for unused nodes
+		int height;
+
+		bool is_leaf() const { return child1 == null_proxy; }
+	};
+
+	std::vector<node> nodes;
+	std::unordered_map<const GameObject*, proxy> leaves;
+	proxy root;
+	proxy free_list;
+	std::size_t leaf_count;
+
+	float margin;
+	float lookahead;
+
+	// Traversal stack, kept to avoid allocating per query
+	std::vector<proxy> stack;
+
+	unsigned int leaves_moved;
+
+public:
+	// margin in world units; lookahead in seconds of velocity
+	AabbTree(float margin = 8.0f, float lookahead = 0.1f)
+		: root(null_proxy), free_list(null_proxy), leaf_count(0), margin(margin), lookahead(lookahead), leaves_moved(0) {}
+
+	AabbTree(const AabbTree&) = delete;
+	AabbTree& operator=(const AabbTree&) = delete;
+
+	// Remove objects before deleting or despawning them. An object is in the
+	// tree at most once.
+	proxy add(GameObject* object) {
+		glm::vec2 min, max;
+		object->get_collision_bounds(min, max);
+
+		proxy leaf = allocate_node();
+		node& n = nodes[leaf];
+		n.object = object;
+		set_boxes(n, min, max, get_step_displacement(*object));
+		n.height = 0;
+		fatten(n, object->get_velocity());
+
+		insert_leaf(leaf);
+		leaves[object] = leaf;
+		leaf_count++;
+		return leaf;
+	}
+
+	void remove(proxy leaf) {
+		if (!is_valid(leaf))
+			return;
+
+		leaves.erase(nodes[leaf].object);
+		remove_leaf(leaf);
+		free_node(leaf);
+		leaf_count--;
+	}
+
+	// The object's leaf, or null_proxy if it is not in the tree
+	proxy find(const GameObject* object) const {
+		auto found = leaves.find(object);
+		return found != leaves.end() ? found->second : null_proxy;
+	}
+
+	bool is_valid(proxy p) const {
+		return p >= 0 && p < static_cast<proxy>(nodes.size()) && nodes[p].height == 0;
+	}
+
+	GameObject* get_object(proxy leaf) const { return is_valid(leaf) ? nodes[leaf].object : nullptr; }
+
+	// New tight box for a leaf, and how far it moved this step. Returns true
+	// if it left its fat box and was reinserted.
+	bool move(proxy leaf, const glm::vec2& min, const glm::vec2& max, const glm::vec2& velocity = glm::vec2(0.0f),
+		const glm::vec2& displacement = glm::vec2(0.0f)) {
+
+		if (!is_valid(leaf))
+			return false;
+
+		node& n = nodes[leaf];
+		set_boxes(n, min, max, displacement);
+
+		if (contains(n.min, n.max, n.swept_min, n.swept_max)) {
+			// Still inside; but a box that was fattened for a fast object
+			// that has since slowed down would make queries visit it
+			// needlessly. Kept while it is at most twice what fatten() would
+			// add for the current velocity.
+			glm::vec2 extent = (n.max - n.min) - (n.swept_max - n.swept_min);
+			glm::vec2 fattening = glm::vec2(2.0f * margin) + glm::abs(velocity * lookahead);
+			if (extent.x <= 2.0f * fattening.x && extent.y <= 2.0f * fattening.y)
+				return false;
+		}
+
+		remove_leaf(leaf);
+		fatten(nodes[leaf], velocity);
+		insert_leaf(leaf);
+		leaves_moved++;
+		return true;
+	}
+
+	// Re-reads the object's collision bounds, velocity and displacement
+	bool refresh(proxy leaf) {
+		if (!is_valid(leaf))
+			return false;
+
+		const GameObject& object = *nodes[leaf].object;
+		glm::vec2 min, max;
+		object.get_collision_bounds(min, max);
+		return move(leaf, min, max, object.get_velocity(), get_step_displacement(object));
+	}
+
+	// refresh() for every leaf; once per step, after movement
+	void update() {
+		leaves_moved = 0;
+		for (proxy i = 0; i < static_cast<proxy>(nodes.size()); i++) {
+			if (nodes[i].height == 0)
+				refresh(i);
+		}
+	}
+
+	// Objects whose boxes contain point
+	void query_point(const glm::vec2& point, std::vector<GameObject*>& results) {
+		query_box(point, point, results);
+	}
+
+	// Objects whose boxes overlap [min, max]
+	void query_box(const glm::vec2& min, const glm::vec2& max, std::vector<GameObject*>& results) {
+		if (root == null_proxy)
+			return;
+
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty()) {
+			const node& n = nodes[stack.back()];
+			stack.pop_back();
+
+			if (!overlaps(n.min, n.max, min, max))
+				continue;
+
+			if (n.is_leaf()) {
+				if (overlaps(n.tight_min, n.tight_max, min, max))
+					results.push_back(n.object);
+			}
+			else {
+				stack.push_back(n.child1);
+				stack.push_back(n.child2);
+			}
+		}
+	}
+
+	// Objects whose swept boxes, covering their whole step, overlap [min, max]
+	void query_swept(const glm::vec2& min, const glm::vec2& max, std::vector<GameObject*>& results) {
+		if (root == null_proxy)
+			return;
+
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty()) {
+			const node& n = nodes[stack.back()];
+			stack.pop_back();
+
+			if (!overlaps(n.min, n.max, min, max))
+				continue;
+
+			if (n.is_leaf()) {
+				if (overlaps(n.swept_min, n.swept_max, min, max))
+					results.push_back(n.object);
+			}
+			else {
+				stack.push_back(n.child1);
+				stack.push_back(n.child2);
+			}
+		}
+	}
+
+	// Every object whose box the ray crosses within max_distance, nearest first
+	void ray_cast(const glm::vec2& origin, const glm::vec2& direction, float max_distance, std::vector<ray_hit>& hits) {
+		std::size_t first = hits.size();
+		glm::vec2 inverse = get_inverse_direction(direction);
+		if (root == null_proxy || inverse == glm::vec2(0.0f))
+			return;
+
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty()) {
+			const node& n = nodes[stack.back()];
+			stack.pop_back();
+
+			float distance;
+			if (!intersect_ray(n.min, n.max, origin, inverse, max_distance, distance))
+				continue;
+
+			if (n.is_leaf()) {
+				if (intersect_ray(n.tight_min, n.tight_max, origin, inverse, max_distance, distance)) {
+					ray_hit hit = { n.object, distance };
+					hits.push_back(hit);
+				}
+			}
+			else {
+				stack.push_back(n.child1);
+				stack.push_back(n.child2);
+			}
+		}
+
+		std::sort(hits.begin() + first, hits.end(),
+			[](const ray_hit& a, const ray_hit& b) { return a.distance < b.distance; });
+	}
+
+	// Nearest object along the ray. Branches farther than the best hit so
+	// far are skipped.
+	bool ray_cast_first(const glm::vec2& origin, const glm::vec2& direction, float max_distance, ray_hit& hit) {
+		glm::vec2 inverse = get_inverse_direction(direction);
+		if (root == null_proxy || inverse == glm::vec2(0.0f))
+			return false;
+
+		bool has_hit = false;
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty()) {
+			const node& n = nodes[stack.back()];
+			stack.pop_back();
+
+			float distance;
+			if (!intersect_ray(n.min, n.max, origin, inverse, max_distance, distance))
+				continue;
+
+			if (n.is_leaf()) {
+				if (intersect_ray(n.tight_min, n.tight_max, origin, inverse, max_distance, distance)) {
+					hit.object = n.object;
+					hit.distance = distance;
+					max_distance = distance;
+					has_hit = true;
+				}
+			}
+			else {
+				stack.push_back(n.child1);
+				stack.push_back(n.child2);
+			}
+		}
+
+		return has_hit;
+	}
+
+	// Visible object under point that is drawn on top (highest layer, then
+	// depth, as RenderQueue orders them), or nullptr
+	GameObject* pick(const glm::vec2& point) {
+		if (root == null_proxy)
+			return nullptr;
+
+		GameObject* best = nullptr;
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty()) {
+			const node& n = nodes[stack.back()];
+			stack.pop_back();
+
+			if (!overlaps(n.min, n.max, point, point))
+				continue;
+
+			if (!n.is_leaf()) {
+				stack.push_back(n.child1);
+				stack.push_back(n.child2);
+				continue;
+			}
+
+			GameObject* object = n.object;
+			if (!object->get_is_visible() || !overlaps(n.tight_min, n.tight_max, point, point))
+				continue;
+
+			if (!best || object->get_layer() > best->get_layer() ||
+				(object->get_layer() == best->get_layer() && object->get_depth() > best->get_depth()))
+				best = object;
+		}
+
+		return best;
+	}
+
+	void clear() {
+		nodes.clear();
+		leaves.clear();
+		root = null_proxy;
+		free_list = null_proxy;
+		leaf_count = 0;
+	}
+
+	std::size_t get_count() const { return leaf_count; }
+	// 0 when empty or a single leaf; about log2 of the count when balanced
+	int get_height() const { return root == null_proxy ? 0 : nodes[root].height; }
+	// Leaves reinserted during the last update()
+	unsigned int get_leaves_moved() const { return leaves_moved; }
+
+	float get_margin() const { return margin; }
+	void set_margin(const float margin) { this->margin = margin; }
+
+	float get_lookahead() const { return lookahead; }
+	void set_lookahead(const float lookahead) { this->lookahead = lookahead; }
+
+private:
+	static bool overlaps(const glm::vec2& a_min, const glm::vec2& a_max, const glm::vec2& b_min, const glm::vec2& b_max) {
+		return !(a_max.x < b_min.x || a_min.x > b_max.x || a_max.y < b_min.y || a_min.y > b_max.y);
+	}
+
+	static bool contains(const glm::vec2& outer_min, const glm::vec2& outer_max, const glm::vec2& min, const glm::vec2& max) {
+		return outer_min.x <= min.x && outer_min.y <= min.y && max.x <= outer_max.x && max.y <= outer_max.y;
+	}
+
+	static float perimeter(const glm::vec2& min, const glm::vec2& max) {
+		return 2.0f * ((max.x - min.x) + (max.y - min.y));
+	}
+
+	// Zero if the direction is zero; infinite components for axis-aligned rays
+	static glm::vec2 get_inverse_direction(const glm::vec2& direction) {
+		float length = glm::length(direction);
+		if (length == 0.0f)
+			return glm::vec2(0.0f);
+
+		glm::vec2 d = direction / length;
+		const float infinity = std::numeric_limits<float>::infinity();
+		return glm::vec2(d.x != 0.0f ? 1.0f / d.x : infinity, d.y != 0.0f ? 1.0f / d.y : infinity);
+	}
+
+	// Slab test; distance is where the ray enters the box, 0 if it starts inside
+	static bool intersect_ray(const glm::vec2& min, const glm::vec2& max, const glm::vec2& origin,
+		const glm::vec2& inverse, float max_distance, float& distance) {
+
+		float t_min = 0.0f;
+		float t_max = max_distance;
+
+		for (int axis = 0; axis < 2; axis++) {
+			if (std::isinf(inverse[axis])) {
+				// Parallel to this slab
+				if (origin[axis] < min[axis] || origin[axis] > max[axis])
+					return false;
+				continue;
+			}
+
+			float t1 = (min[axis] - origin[axis]) * inverse[axis];
+			float t2 = (max[axis] - origin[axis]) * inverse[axis];
+			if (t1 > t2)
+				std::swap(t1, t2);
+
+			t_min = std::max(t_min, t1);
+			t_max = std::min(t_max, t2);
+			if (t_min > t_max)
+				return false;
+		}
+
+		distance = t_min;
+		return true;
+	}
+
+	// Children move in their parent's space; their displacement is not a
+	// world-space step
+	static glm::vec2 get_step_displacement(const GameObject& object) {
+		return object.get_parent() ? glm::vec2(0.0f) : object.get_displacement();
+	}
+
+	static void set_boxes(node& n, const glm::vec2& min, const glm::vec2& max, const glm::vec2& displacement) {
+		n.tight_min = min;
+		n.tight_max = max;
+		n.swept_min = glm::min(min, min - displacement);
+		n.swept_max = glm::max(max, max - displacement);
+	}
+
+	void fatten(node& n, const glm::vec2& velocity) {
+		n.min = n.swept_min - glm::vec2(margin);
+		n.max = n.swept_max + glm::vec2(margin);
+
+		// Stretched only in the direction the object is heading
+		glm::vec2 displacement = velocity * lookahead;
+		n.min += glm::min(displacement, glm::vec2(0.0f));
+		n.max += glm::max(displacement, glm::vec2(0.0f));
+	}
+
+	proxy allocate_node() {
+		proxy index;
+		if (free_list != null_proxy) {
+			index = free_list;
+			free_list = nodes[index].parent;
+		}
+		else {
+			index = static_cast<proxy>(nodes.size());
+			nodes.push_back(node());
+		}
+
+		node& n = nodes[index];
+		n.parent = null_proxy;
+		n.child1 = null_proxy;
+		n.child2 = null_proxy;
+		n.object = nullptr;
+		n.height = 0;
+		return index;
+	}
+
+	void free_node(proxy index) {
+		nodes[index].parent = free_list;
+		nodes[index].height = -1;
+		free_list = index;
+	}
+
+	void insert_leaf(proxy leaf) {
+		if (root == null_proxy) {
+			root = leaf;
+			nodes[leaf].parent = null_proxy;
+			return;
+		}
+
+		// Walk down to the sibling that makes the tree grow least
+		glm::vec2 leaf_min = nodes[leaf].min;
+		glm::vec2 leaf_max = nodes[leaf].max;
+		proxy index = root;
+		while (!nodes[index].is_leaf()) {
+			const node& n = nodes[index];
+
+			float area = perimeter(n.min, n.max);
+			float combined = perimeter(glm::min(n.min, leaf_min), glm::max(n.max, leaf_max));
+
+			// Pairing with this node creates a parent of the combined size;
+			// going further down still grows this node to that size
+			float cost = 2.0f * combined;
+			float inheritance = 2.0f * (combined - area);
+
+			float cost1 = descend_cost(n.child1, leaf_min, leaf_max) + inheritance;
+			float cost2 = descend_cost(n.child2, leaf_min, leaf_max) + inheritance;
+
+			if (cost < cost1 && cost < cost2)
+				break;
+
+			index = cost1 < cost2 ? n.child1 : n.child2;
+		}
+
+		proxy sibling = index;
+		proxy old_parent = nodes[sibling].parent;
+		proxy new_parent = allocate_node();
+
+		nodes[new_parent].parent = old_parent;
+		nodes[new_parent].min = glm::min(nodes[sibling].min, leaf_min);
+		nodes[new_parent].max = glm::max(nodes[sibling].max, leaf_max);
+		nodes[new_parent].height = nodes[sibling].height + 1;
+		nodes[new_parent].child1 = sibling;
+		nodes[new_parent].child2 = leaf;
+		nodes[sibling].parent = new_parent;
+		nodes[leaf].parent = new_parent;
+
+		if (old_parent != null_proxy) {
+			if (nodes[old_parent].child1 == sibling)
+				nodes[old_parent].child1 = new_parent;
+			else
+				nodes[old_parent].child2 = new_parent;
+		}
+		else {
+			root = new_parent;
+		}
+
+		refit_upwards(nodes[leaf].parent);
+	}
+
+	float descend_cost(proxy child, const glm::vec2& leaf_min, const glm::vec2& leaf_max) const {
+		const node& c = nodes[child];
+		float combined = perimeter(glm::min(c.min, leaf_min), glm::max(c.max, leaf_max));
+		return c.is_leaf() ? combined : combined - perimeter(c.min, c.max);
+	}
+
+	void remove_leaf(proxy leaf) {
+		if (leaf == root) {
+			root = null_proxy;
+			return;
+		}
+
+		proxy parent = nodes[leaf].parent;
+		proxy grand_parent = nodes[parent].parent;
+		proxy sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+		if (grand_parent != null_proxy) {
+			if (nodes[grand_parent].child1 == parent)
+				nodes[grand_parent].child1 = sibling;
+			else
+				nodes[grand_parent].child2 = sibling;
+			nodes[sibling].parent = grand_parent;
+			free_node(parent);
+
+			refit_upwards(grand_parent);
+		}
+		else {
+			root = sibling;
+			nodes[sibling].parent = null_proxy;
+			free_node(parent);
+		}
+	}
+
+	// Rebalances and refits every node from index up to the root
+	void refit_upwards(proxy index) {
+		while (index != null_proxy) {
+			index = balance(index);
+
+			node& n = nodes[index];
+			const node& child1 = nodes[n.child1];
+			const node& child2 = nodes[n.child2];
+			n.height = 1 + std::max(child1.height, child2.height);
+			n.min = glm::min(child1.min, child2.min);
+			n.max = glm::max(child1.max, child2.max);
+
+			index = n.parent;
+		}
+	}
+
+	// If one child of a is more than one level taller than the other, the
+	// taller child takes a's place and a takes one of its children. Returns
+	// the node now at a's position.
+	proxy balance(proxy a) {
+		node& node_a = nodes[a];
+		if (node_a.is_leaf() || node_a.height < 2)
+			return a;
+
+		proxy b = node_a.child1;
+		proxy c = node_a.child2;
+		int difference = nodes[c].height - nodes[b].height;
+
+		if (difference > 1)
+			return rotate(a, c, b);
+		if (difference < -1)
+			return rotate(a, b, c);
+		return a;
+	}
+
+	// up is the taller child of a and moves up into a's place; other is
+	// a's other child. up keeps its taller child and gives the shorter one
+	// to a.
+	proxy rotate(proxy a, proxy up, proxy other) {
+		node& node_a = nodes[a];
+		node& node_up = nodes[up];
+
+		proxy f = node_up.child1;
+		proxy g = node_up.child2;
+
+		node_up.child1 = a;
+		node_up.parent = node_a.parent;
+		node_a.parent = up;
+
+		if (node_up.parent != null_proxy) {
+			if (nodes[node_up.parent].child1 == a)
+				nodes[node_up.parent].child1 = up;
+			else
+				nodes[node_up.parent].child2 = up;
+		}
+		else {
+			root = up;
+		}
+
+		proxy keep = nodes[f].height > nodes[g].height ? f : g;
+		proxy give = keep == f ? g : f;
+
+		node_up.child2 = keep;
+		node_a.child1 = other;
+		node_a.child2 = give;
+		nodes[give].parent = a;
+
+		node_a.min = glm::min(nodes[other].min, nodes[give].min);
+		node_a.max = glm::max(nodes[other].max, nodes[give].max);
+		node_a.height = 1 + std::max(nodes[other].height, nodes[give].height);
+
+		node_up.min = glm::min(node_a.min, nodes[keep].min);
+		node_up.max = glm::max(node_a.max, nodes[keep].max);
+		node_up.height = 1 + std::max(node_a.height, nodes[keep].height);
+
+		return up;
+	}
+};
+
+const AabbTree::proxy AabbTree::null_proxy;
@@ -0,0 +1,225 @@
+#pragma once
+#include "Simd.h"
+
+#include <glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// What happens to a moving object that leaves the world bounds
+enum class boundary_policy : std::uint8_t {
+	clamp,	// stops at the edge, what check_edges always did
+	wrap,	// comes back in on the opposite side
+	bounce,	// reflected back in, velocity flipped on that axis
+	kill	// removed by its owner
+};
+
+// World bounds, cached from reshape() so updates never ask GLUT for the
+// window size, plus the kernels that move objects and keep them inside.
+class Boundary {
+private:
+	static glm::vec2 world_min;
+	static glm::vec2 world_max;
+
+public:
+	// Only from the GLUT thread while no update is running
+	static void set_world(const glm::vec2& min, const glm::vec2& max) {
+		world_min = min;
+		world_max = max;
+	}
+
+	static glm::vec2 get_world_min() { return world_min; }
+	static glm::vec2 get_world_max() { return world_max; }
+
+	// Applies the policy to a position that may be outside [min, max].
+	// Returns false if a kill policy removed it; the position is left as is.
+	// A wrap moves previous, if given, by as much as the position, so
+	// interpolating between them stays on the short path.
+	static bool resolve(glm::vec2& position, glm::vec2& velocity, boundary_policy policy,
+		const glm::vec2& min, const glm::vec2& max, glm::vec2* previous = nullptr) {
+
+		for (int axis = 0; axis < 2; axis++) {
+			float& p = position[axis];
+			float lo = min[axis];
+			float hi = max[axis];
+			if (p >= lo && p <= hi)
+				continue;
+
+			switch (policy) {
+			case boundary_policy::kill:
+				return false;
+			case boundary_policy::wrap: {
+				float size = hi - lo;
+				float unwrapped = p;
+				if (size > 0.0f) {
+					p = lo + fmod(p - lo, size);
+					if (p < lo)
+						p += size;
+				}
+				else {
+					p = lo;
+				}
+				if (previous)
+					(*previous)[axis] += p - unwrapped;
+				break;
+			}
+			case boundary_policy::bounce:
+				// Always back inwards, even if it was already heading that way
+				if (p > hi) {
+					p = 2.0f * hi - p;
+					velocity[axis] = -fabs(velocity[axis]);
+				}
+				else {
+					p = 2.0f * lo - p;
+					velocity[axis] = fabs(velocity[axis]);
+				}
+				p = glm::clamp(p, lo, hi);
+				break;
+			default:
+				p = glm::clamp(p, lo, hi);
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	// position += velocity * dt for count objects, then the boundary policy
+	// for any that left [min, max]. policy may be nullptr, meaning clamp for
+	// all of them, which keeps the whole pass in vector registers. Indices
+	// of objects a kill policy removed are appended to killed. previous, if
+	// not nullptr, is moved along with wrapped positions (see resolve()).
+	// Returns whether any position changed.
+	static bool integrate(glm::vec2* position, glm::vec2* previous, glm::vec2* velocity, const boundary_policy* policy,
+		std::size_t count, float dt, const glm::vec2& min, const glm::vec2& max, std::vector<std::size_t>& killed) {
+
+		float* p = &position[0].x;
+		const float* v = &velocity[0].x;
+		std::size_t i = 0;
+		bool has_moved = false;
+
+		// Positions are interleaved x, y, so the bounds are too; blocks with
+		// an object outside are redone one object at a time below
+#if defined(SIMD_AVX2)
+		{
+			const __m256 dt8 = _mm256_set1_ps(dt);
+			const __m256 min8 = _mm256_setr_ps(min.x, min.y, min.x, min.y, min.x, min.y, min.x, min.y);
+			const __m256 max8 = _mm256_setr_ps(max.x, max.y, max.x, max.y, max.x, max.y, max.x, max.y);
+			__m256 moved = _mm256_setzero_ps();
+
+			for (; i + 4 <= count; i += 4) {
+				__m256 old = _mm256_loadu_ps(p + 2 * i);
+				__m256 next = _mm256_add_ps(old, _mm256_mul_ps(_mm256_loadu_ps(v + 2 * i), dt8));
+
+				if (!policy) {
+					next = _mm256_min_ps(_mm256_max_ps(next, min8), max8);
+				}
+				else {
+					__m256 outside = _mm256_or_ps(_mm256_cmp_ps(next, min8, _CMP_LT_OQ), _mm256_cmp_ps(next, max8, _CMP_GT_OQ));
+					if (_mm256_movemask_ps(outside)) {
+						has_moved |= step_range(position, previous, velocity, policy, i, i + 4, dt, min, max, killed);
+						continue;
+					}
+				}
+
+				moved = _mm256_or_ps(moved, _mm256_cmp_ps(next, old, _CMP_NEQ_UQ));
+				_mm256_storeu_ps(p + 2 * i, next);
+			}
+
+			has_moved |= _mm256_movemask_ps(moved) != 0;
+		}
+#endif
+#if defined(SIMD_SSE2)
+		{
+			const __m128 dt4 = _mm_set1_ps(dt);
+			const __m128 min4 = _mm_setr_ps(min.x, min.y, min.x, min.y);
+			const __m128 max4 = _mm_setr_ps(max.x, max.y, max.x, max.y);
+			__m128 moved = _mm_setzero_ps();
+
+			for (; i + 2 <= count; i += 2) {
+				__m128 old = _mm_loadu_ps(p + 2 * i);
+				__m128 next = _mm_add_ps(old, _mm_mul_ps(_mm_loadu_ps(v + 2 * i), dt4));
+
+				if (!policy) {
+					next = _mm_min_ps(_mm_max_ps(next, min4), max4);
+				}
+				else {
+					__m128 outside = _mm_or_ps(_mm_cmplt_ps(next, min4), _mm_cmpgt_ps(next, max4));
+					if (_mm_movemask_ps(outside)) {
+						has_moved |= step_range(position, previous, velocity, policy, i, i + 2, dt, min, max, killed);
+						continue;
+					}
+				}
+
+				moved = _mm_or_ps(moved, _mm_cmpneq_ps(next, old));
+				_mm_storeu_ps(p + 2 * i, next);
+			}
+
+			has_moved |= _mm_movemask_ps(moved) != 0;
+		}
+#endif
+#if defined(SIMD_NEON)
+		{
+			const float32x4_t dt4 = vdupq_n_f32(dt);
+			const float bounds_min[4] = { min.x, min.y, min.x, min.y };
+			const float bounds_max[4] = { max.x, max.y, max.x, max.y };
+			const float32x4_t min4 = vld1q_f32(bounds_min);
+			const float32x4_t max4 = vld1q_f32(bounds_max);
+			uint32x4_t moved = vdupq_n_u32(0);
+
+			for (; i + 2 <= count; i += 2) {
+				float32x4_t old = vld1q_f32(p + 2 * i);
+				float32x4_t next = vaddq_f32(old, vmulq_f32(vld1q_f32(v + 2 * i), dt4));
+
+				if (!policy) {
+					next = vminq_f32(vmaxq_f32(next, min4), max4);
+				}
+				else {
+					uint32x4_t outside = vorrq_u32(vcltq_f32(next, min4), vcgtq_f32(next, max4));
+					if (any_lane(outside)) {
+						has_moved |= step_range(position, previous, velocity, policy, i, i + 2, dt, min, max, killed);
+						continue;
+					}
+				}
+
+				moved = vorrq_u32(moved, vmvnq_u32(vceqq_f32(next, old)));
+				vst1q_f32(p + 2 * i, next);
+			}
+
+			has_moved |= any_lane(moved);
+		}
+#endif
+		has_moved |= step_range(position, previous, velocity, policy, i, count, dt, min, max, killed);
+		return has_moved;
+	}
+
+private:
+	// Scalar integrate() for [first, last)
+	static bool step_range(glm::vec2* position, glm::vec2* previous, glm::vec2* velocity, const boundary_policy* policy,
+		std::size_t first, std::size_t last, float dt, const glm::vec2& min, const glm::vec2& max,
+		std::vector<std::size_t>& killed) {
+
+		bool has_moved = false;
+		for (std::size_t i = first; i < last; i++) {
+			glm::vec2 old_position = position[i];
+			position[i] = old_position + velocity[i] * dt;
+
+			if (!resolve(position[i], velocity[i], policy ? policy[i] : boundary_policy::clamp, min, max,
+				previous ? &previous[i] : nullptr))
+				killed.push_back(i);
+			has_moved |= position[i] != old_position;
+		}
+		return has_moved;
+	}
+
+#if defined(SIMD_NEON)
+	static bool any_lane(uint32x4_t mask) {
+		uint32x2_t halves = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+		return (vget_lane_u32(halves, 0) | vget_lane_u32(halves, 1)) != 0;
+	}
+#endif
+};
+
+glm::vec2 Boundary::world_min = glm::vec2(0.0f);
+glm::vec2 Boundary::world_max = glm::vec2(0.0f);
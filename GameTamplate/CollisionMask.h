@@ -0,0 +1,173 @@
+#pragma once
+#include "SOIL2.h"
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One bit per texel of every frame of a sprite sheet, set where the alpha
+// is at least a threshold, packed 64 columns to a word.
+//
+// Rows are stored bottom-up, matching the sprite's local y, and every frame
+// is also kept mirrored horizontally so flipped sprites test just as fast.
+// Two masks drawn at one texel per world unit without rotation overlap if
+// any pair of rows ANDs to non-zero once one is shifted by the offset
+// between them; overlaps() does that a word at a time.
+class CollisionMask {
+private:
+	int frame_width;
+	int frame_height;
+	int words_per_row;
+	unsigned int frame_count;
+
+	// Frame f, mirrored m, row r at ((f * 2 + m) * frame_height + r) * words_per_row
+	std::vector<std::uint64_t> bits;
+
+	static std::map<std::string, std::unique_ptr<CollisionMask>> cache;
+
+public:
+	// pixels is the whole sheet as RGBA, top row first, the way SOIL loads it.
+	// Frames are read left to right, top to bottom, like Sprite plays them.
+	CollisionMask(const unsigned char* pixels, int width, int height, const glm::ivec2& number_of_frames,
+		unsigned char alpha_threshold = 128)
+		: frame_width(width / glm::max(number_of_frames.x, 1)), frame_height(height / glm::max(number_of_frames.y, 1)),
+		words_per_row((frame_width + 63) / 64),
+		frame_count(static_cast<unsigned int>(glm::max(number_of_frames.x, 1) * glm::max(number_of_frames.y, 1))) {
+
+		bits.assign(frame_count * 2 * frame_height * words_per_row, 0);
+		int columns = glm::max(number_of_frames.x, 1);
+
+		for (unsigned int frame = 0; frame < frame_count; frame++) {
+			int left = static_cast<int>(frame % columns) * frame_width;
+			int top = static_cast<int>(frame / columns) * frame_height;
+
+			for (int row = 0; row < frame_height; row++) {
+				const unsigned char* source = pixels + ((top + frame_height - 1 - row) * width + left) * 4;
+				std::uint64_t* plain = get_row(frame, false, row);
+				std::uint64_t* mirrored = get_row(frame, true, row);
+
+				for (int x = 0; x < frame_width; x++) {
+					if (source[x * 4 + 3] < alpha_threshold)
+						continue;
+
+					int m = frame_width - 1 - x;
+					plain[x >> 6] |= std::uint64_t(1) << (x & 63);
+					mirrored[m >> 6] |= std::uint64_t(1) << (m & 63);
+				}
+			}
+		}
+	}
+
+	CollisionMask(const CollisionMask&) = delete;
+	CollisionMask& operator=(const CollisionMask&) = delete;
+
+	// Loads the image once per file, frame layout and threshold; sprites
+	// sharing a sheet share its mask. Returns nullptr if loading failed.
+	// Masks live as long as the program, like textures.
+	static const CollisionMask* load(const char* file_name, const glm::vec2& number_of_frames,
+		unsigned char alpha_threshold = 128) {
+
+		glm::ivec2 frames(number_of_frames);
+		char suffix[64];
+		snprintf(suffix, sizeof(suffix), "|%dx%d|%d", frames.x, frames.y, alpha_threshold);
+		std::string key = std::string(file_name) + suffix;
+
+		auto found = cache.find(key);
+		if (found != cache.end())
+			return found->second.get();
+
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		unsigned char* pixels = SOIL_load_image(file_name, &width, &height, &channels, SOIL_LOAD_RGBA);
+		if (!pixels)
+			return nullptr;
+
+		CollisionMask* mask = new CollisionMask(pixels, width, height, frames, alpha_threshold);
+		SOIL_free_image_data(pixels);
+
+		cache[key].reset(mask);
+		return mask;
+	}
+
+	int get_frame_width() const { return frame_width; }
+	int get_frame_height() const { return frame_height; }
+	unsigned int get_frame_count() const { return frame_count; }
+
+	// x and y in texels from the frame's bottom-left corner, before the flip
+	// is applied. Frames past the end (sprites made of separate images) use
+	// the first one.
+	bool get_pixel(unsigned int frame, const glm::bvec2& flip, int x, int y) const {
+		if (x < 0 || y < 0 || x >= frame_width || y >= frame_height)
+			return false;
+
+		if (flip.y)
+			y = frame_height - 1 - y;
+		const std::uint64_t* row = get_row(get_frame(frame), flip.x, y);
+		return (row[x >> 6] >> (x & 63)) & 1;
+	}
+
+	// Whether the set texels of two frames meet when b's bottom-left corner
+	// is offset texels from a's
+	static bool overlaps(const CollisionMask& a, unsigned int frame_a, const glm::bvec2& flip_a,
+		const CollisionMask& b, unsigned int frame_b, const glm::bvec2& flip_b, const glm::ivec2& offset) {
+
+		int x0 = glm::max(0, offset.x);
+		int x1 = glm::min(a.frame_width, offset.x + b.frame_width);
+		int y0 = glm::max(0, offset.y);
+		int y1 = glm::min(a.frame_height, offset.y + b.frame_height);
+		if (x0 >= x1 || y0 >= y1)
+			return false;
+
+		frame_a = a.get_frame(frame_a);
+		frame_b = b.get_frame(frame_b);
+		int first_word = x0 >> 6;
+		int last_word = (x1 - 1) >> 6;
+
+		for (int y = y0; y < y1; y++) {
+			int row_a = flip_a.y ? a.frame_height - 1 - y : y;
+			int row_b = flip_b.y ? b.frame_height - 1 - (y - offset.y) : y - offset.y;
+			const std::uint64_t* bits_a = a.get_row(frame_a, flip_a.x, row_a);
+			const std::uint64_t* bits_b = b.get_row(frame_b, flip_b.x, row_b);
+
+			// Texels past either frame's width are zero, so whole words can be ANDed
+			for (int word = first_word; word <= last_word; word++) {
+				if (bits_a[word] & extract(bits_b, b.words_per_row, word * 64 - offset.x))
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	unsigned int get_frame(unsigned int frame) const { return frame < frame_count ? frame : 0; }
+
+	std::uint64_t* get_row(unsigned int frame, bool is_mirrored, int row) {
+		return &bits[((frame * 2 + (is_mirrored ? 1 : 0)) * frame_height + row) * words_per_row];
+	}
+
+	const std::uint64_t* get_row(unsigned int frame, bool is_mirrored, int row) const {
+		return &bits[((frame * 2 + (is_mirrored ? 1 : 0)) * frame_height + row) * words_per_row];
+	}
+
+	// 64 bits of a row starting at column first, which may lie outside it
+	static std::uint64_t extract(const std::uint64_t* row, int words, int first) {
+		int word = first >= 0 ? first / 64 : -((63 - first) / 64);
+		int shift = first - word * 64;
+
+		std::uint64_t low = (word >= 0 && word < words) ? row[word] : 0;
+		if (shift == 0)
+			return low;
+
+		std::uint64_t high = (word + 1 >= 0 && word + 1 < words) ? row[word + 1] : 0;
+		return (low >> shift) | (high << (64 - shift));
+	}
+};
+
+std::map<std::string, std::unique_ptr<CollisionMask>> CollisionMask::cache;
@@ -0,0 +1,320 @@
+#pragma once
+#include "AabbTree.h"
+#include "Narrowphase.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// First contact of a fast mover along its step. normal points from the
+// obstacle's surface towards the mover.
+struct impact {
+	GameObject* mover;
+	GameObject* obstacle;
+	// Fraction of the step, 0 to 1, at which they touched
+	float time;
+	glm::vec2 normal;
+};
+
+// Swept tests for objects that moved farther in one step than they are
+// thick, which the discrete tests would let pass through thin obstacles.
+//
+// Every other object is left to the discrete tests. A fast mover is swept
+// from where its step began to where it ended, against each object in the
+// tree whose swept box (AabbTree::query_swept) its own swept box meets,
+// with the obstacle's own movement taken into account. At the earliest
+// impact it is put back to where it touched, less a small skin, its leaf
+// is refreshed, and the impact is reported; its velocity is left to the
+// caller. Shapes are circles for circle primitives and boxes
+// (the collision bounds) for everything else, and only translation is
+// swept, not rotation.
+//
+// Fast movers are handled fastest first, relative to their size, and a
+// budget caps the number of sweeps per step, so a burst of projectiles
+// cannot stall a frame. A mover is swept against all of its candidates or
+// none; one whose candidates no longer fit in the budget moves as usual
+// that step.
+class ContinuousCollision {
+public:
+	struct swept_shape {
+		bool is_circle;
+		glm::vec2 center;
+		// Boxes only
+		glm::vec2 half_extent;
+		// Circles only
+		float radius;
+	};
+
+private:
+	struct mover {
+		GameObject* object;
+		// Displacement divided by extent, how likely it was to tunnel
+		float ratio;
+	};
+
+	std::vector<mover> movers;
+	std::vector<GameObject*> candidates;
+
+	unsigned int max_sweeps;
+	float skin;
+
+	unsigned int sweeps;
+	unsigned int movers_skipped;
+
+public:
+	ContinuousCollision(unsigned int max_sweeps = 1024, float skin = 0.01f)
+		: max_sweeps(max_sweeps), skin(skin), sweeps(0), movers_skipped(0) {}
+
+	ContinuousCollision(const ContinuousCollision&) = delete;
+	ContinuousCollision& operator=(const ContinuousCollision&) = delete;
+
+	// After the step has moved objects and tree is up to date. Only objects
+	// without a parent are checked as movers.
+	void resolve(const std::vector<GameObject*>& objects, AabbTree& tree, std::vector<impact>& impacts) {
+		sweeps = 0;
+		movers_skipped = 0;
+		movers.clear();
+
+		for (GameObject* object : objects) {
+			if (!object->get_is_active() || object->get_parent())
+				continue;
+
+			glm::vec2 displacement = object->get_displacement();
+			float distance = glm::length(displacement);
+			if (distance == 0.0f)
+				continue;
+
+			swept_shape shape;
+			make_shape(*object, shape);
+			float extent = shape.is_circle ? shape.radius : glm::min(shape.half_extent.x, shape.half_extent.y);
+			if (distance <= extent)
+				continue;
+
+			mover m = { object, extent > 0.0f ? distance / extent : FLT_MAX };
+			movers.push_back(m);
+		}
+
+		std::sort(movers.begin(), movers.end(), [](const mover& a, const mover& b) { return a.ratio > b.ratio; });
+
+		for (const mover& m : movers) {
+			find_candidates(*m.object, tree);
+			if (candidates.size() > max_sweeps - sweeps) {
+				movers_skipped++;
+				continue;
+			}
+
+			sweeps += static_cast<unsigned int>(candidates.size());
+			resolve_mover(*m.object, tree, impacts);
+		}
+	}
+
+	// Time of impact of mover, moving by displacement, with obstacle kept
+	// still; both at their positions where the step began. Pairs already
+	// touching at the start are left to the discrete tests.
+	static bool sweep(const swept_shape& mover, const swept_shape& obstacle, const glm::vec2& displacement,
+		float& time, glm::vec2& normal) {
+
+		if (mover.is_circle && obstacle.is_circle)
+			return sweep_circle(mover.center - obstacle.center, displacement, mover.radius + obstacle.radius, time, normal);
+
+		if (!mover.is_circle && !obstacle.is_circle)
+			return sweep_box(mover.center - obstacle.center, displacement, mover.half_extent + obstacle.half_extent, time, normal);
+
+		// A circle against a box is the circle's center against the box
+		// grown by the radius, with rounded corners
+		if (mover.is_circle)
+			return sweep_rounded_box(mover.center - obstacle.center, displacement, obstacle.half_extent, mover.radius, time, normal);
+
+		if (!sweep_rounded_box(obstacle.center - mover.center, -displacement, mover.half_extent, obstacle.radius, time, normal))
+			return false;
+		normal = -normal;
+		return true;
+	}
+
+	// Shape at the object's current simulation state
+	static void make_shape(const GameObject& object, swept_shape& shape) {
+		collision_shape circle;
+		if (object.get_primitive_type() == primitive_type::circle && Narrowphase::make_shape(object, circle)) {
+			shape.is_circle = true;
+			shape.center = circle.center;
+			shape.radius = circle.radius;
+			shape.half_extent = glm::vec2(circle.radius);
+			return;
+		}
+
+		glm::vec2 min, max;
+		object.get_collision_bounds(min, max);
+		shape.is_circle = false;
+		shape.center = (min + max) * 0.5f;
+		shape.half_extent = (max - min) * 0.5f;
+		shape.radius = 0.0f;
+	}
+
+	// Sweeps run during the last resolve()
+	unsigned int get_sweeps() const { return sweeps; }
+	// Fast movers the budget ran out for during the last resolve()
+	unsigned int get_movers_skipped() const { return movers_skipped; }
+
+	unsigned int get_max_sweeps() const { return max_sweeps; }
+	void set_max_sweeps(const unsigned int max_sweeps) { this->max_sweeps = max_sweeps; }
+
+	float get_skin() const { return skin; }
+	void set_skin(const float skin) { this->skin = skin; }
+
+private:
+	// Active objects other than object whose swept boxes meet its own
+	void find_candidates(GameObject& object, AabbTree& tree) {
+		glm::vec2 displacement = object.get_displacement();
+
+		swept_shape shape;
+		make_shape(object, shape);
+		glm::vec2 end_min = shape.center - shape.half_extent;
+		glm::vec2 end_max = shape.center + shape.half_extent;
+
+		candidates.clear();
+		tree.query_swept(glm::min(end_min, end_min - displacement), glm::max(end_max, end_max - displacement), candidates);
+		candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+			[&object](GameObject* obstacle) { return obstacle == &object || !obstacle->get_is_active(); }), candidates.end());
+	}
+
+	// Sweeps object against the candidates
+	void resolve_mover(GameObject& object, AabbTree& tree, std::vector<impact>& impacts) {
+		glm::vec2 displacement = object.get_displacement();
+
+		swept_shape shape;
+		make_shape(object, shape);
+		shape.center -= displacement;
+
+		impact first = { &object, nullptr, 1.0f, glm::vec2(0.0f) };
+		glm::vec2 first_displacement(0.0f);
+
+		for (GameObject* obstacle : candidates) {
+			// Children are swept where they are; their displacement is in their parent's space
+			glm::vec2 obstacle_displacement = obstacle->get_parent() ? glm::vec2(0.0f) : obstacle->get_displacement();
+
+			swept_shape obstacle_shape;
+			make_shape(*obstacle, obstacle_shape);
+			obstacle_shape.center -= obstacle_displacement;
+
+			float time;
+			glm::vec2 normal;
+			glm::vec2 relative = displacement - obstacle_displacement;
+			if (sweep(shape, obstacle_shape, relative, time, normal) && time < first.time) {
+				first.obstacle = obstacle;
+				first.time = time;
+				first.normal = normal;
+				first_displacement = relative;
+			}
+		}
+
+		if (!first.obstacle)
+			return;
+
+		// Back to where it touched the obstacle, measured from where the
+		// obstacle ended up
+		float length = glm::length(first_displacement);
+		float time = length > 0.0f ? glm::max(first.time - skin / length, 0.0f) : 0.0f;
+		object.set_position(object.get_position() - first_displacement * (1.0f - time));
+		tree.refresh(tree.find(&object));
+		impacts.push_back(first);
+	}
+
+	// Point at start moving by displacement against a circle of radius at
+	// the origin
+	static bool sweep_circle(const glm::vec2& start, const glm::vec2& displacement, float radius,
+		float& time, glm::vec2& normal) {
+
+		float c = glm::dot(start, start) - radius * radius;
+		if (c <= 0.0f)
+			return false;
+
+		float a = glm::dot(displacement, displacement);
+		float b = glm::dot(start, displacement);
+		if (a == 0.0f || b >= 0.0f)
+			return false;
+
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+			return false;
+
+		time = (-b - std::sqrt(discriminant)) / a;
+		if (time > 1.0f)
+			return false;
+
+		normal = glm::normalize(start + displacement * time);
+		return true;
+	}
+
+	// Point at start moving by displacement against a box of half_extent at
+	// the origin
+	static bool sweep_box(const glm::vec2& start, const glm::vec2& displacement, const glm::vec2& half_extent,
+		float& time, glm::vec2& normal) {
+
+		if (std::fabs(start.x) < half_extent.x && std::fabs(start.y) < half_extent.y)
+			return false;
+
+		float t_enter = 0.0f;
+		float t_exit = 1.0f;
+		int enter_axis = -1;
+
+		for (int axis = 0; axis < 2; axis++) {
+			if (displacement[axis] == 0.0f) {
+				if (std::fabs(start[axis]) >= half_extent[axis])
+					return false;
+				continue;
+			}
+
+			float inverse = 1.0f / displacement[axis];
+			float t1 = (-half_extent[axis] - start[axis]) * inverse;
+			float t2 = (half_extent[axis] - start[axis]) * inverse;
+			if (t1 > t2)
+				std::swap(t1, t2);
+
+			// Ties at 0 count, for a start right on the face
+			if (t1 > t_enter || (t1 == t_enter && enter_axis < 0)) {
+				t_enter = t1;
+				enter_axis = axis;
+			}
+			t_exit = glm::min(t_exit, t2);
+			if (t_enter > t_exit)
+				return false;
+		}
+
+		// Starting on a face and moving along it does not count
+		if (enter_axis < 0)
+			return false;
+
+		time = t_enter;
+		normal = glm::vec2(0.0f);
+		normal[enter_axis] = displacement[enter_axis] > 0.0f ? -1.0f : 1.0f;
+		return true;
+	}
+
+	static bool sweep_rounded_box(const glm::vec2& start, const glm::vec2& displacement, const glm::vec2& half_extent,
+		float radius, float& time, glm::vec2& normal) {
+
+		// Starting in a corner square of the grown box but clear of the
+		// rounded corner, only that corner can be hit first
+		glm::vec2 grown = half_extent + glm::vec2(radius);
+		if (std::fabs(start.x) < grown.x && std::fabs(start.y) < grown.y) {
+			if (std::fabs(start.x) <= half_extent.x || std::fabs(start.y) <= half_extent.y)
+				return false;
+
+			glm::vec2 corner(start.x > 0.0f ? half_extent.x : -half_extent.x, start.y > 0.0f ? half_extent.y : -half_extent.y);
+			return sweep_circle(start - corner, displacement, radius, time, normal);
+		}
+
+		if (!sweep_box(start, displacement, grown, time, normal))
+			return false;
+
+		// Entering through a face of the grown box is a hit on that face;
+		// through one of its corner squares, only if the rounded corner is hit
+		glm::vec2 hit = start + displacement * time;
+		if (std::fabs(hit.x) <= half_extent.x || std::fabs(hit.y) <= half_extent.y)
+			return true;
+
+		glm::vec2 corner(hit.x > 0.0f ? half_extent.x : -half_extent.x, hit.y > 0.0f ? half_extent.y : -half_extent.y);
+		return sweep_circle(start - corner, displacement, radius, time, normal);
+	}
+};
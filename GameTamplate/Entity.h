@@ -0,0 +1,128 @@
+#pragma once
+#include "EntityStore.h"
+
+// Accessors for an entity in an EntityStore, named like GameObject's
+// (get_position(), get_sprite(), ...). Only the accessors: updating and
+// rendering are the store's systems, and there are no bounds or collision
+// queries. It is a store pointer and an id, cheap to copy; the data itself
+// stays in the store's columns.
+//
+// Once the entity is destroyed, getters return defaults and setters do
+// nothing, even if its slot has been reused.
+class Entity {
+private:
+	EntityStore* store;
+	EntityStore::entity id;
+
+public:
+	Entity() : store(nullptr), id(EntityStore::null_entity) {}
+	Entity(EntityStore* store, EntityStore::entity id) : store(store), id(id) {}
+
+	EntityStore::entity get_id() const { return id; }
+	EntityStore* get_store() const { return store; }
+	bool is_valid() const { return store && store->is_alive(id); }
+
+	glm::vec2 get_position() const { return is_valid() ? columns().position[index()] : glm::vec2(0.0f); }
+	void set_position(const glm::vec2& new_position) {
+		if (is_valid())
+			Redraw::assign(columns().position[index()], new_position);
+	}
+
+	glm::vec2 get_velocity() const {
+		return has(EntityStore::component_velocity) ? columns().velocity[index()] : glm::vec2(0.0f);
+	}
+	void set_velocity(const glm::vec2& new_velocity) {
+		if (store)
+			store->set_velocity(id, new_velocity);
+	}
+
+	glm::vec3 get_line() const { return has_shape() ? columns().shapes[index()].line : glm::vec3(0.0f); }
+	void set_line(const glm::vec3& new_line) {
+		if (has_shape())
+			Redraw::assign(columns().shapes[index()].line, new_line);
+	}
+
+	glm::vec3 get_fill() const { return has_shape() ? columns().shapes[index()].fill : glm::vec3(0.0f); }
+	void set_fill(const glm::vec3& new_fill) {
+		if (has_shape())
+			Redraw::assign(columns().shapes[index()].fill, new_fill);
+	}
+
+	float get_rotation() const { return is_valid() ? columns().rotation[index()] : 0.0f; }
+	void set_rotation(float new_rotation) {
+		if (is_valid())
+			Redraw::assign(columns().rotation[index()], new_rotation);
+	}
+
+	glm::vec2 get_scale() const { return is_valid() ? columns().scale[index()] : glm::vec2(1.0f); }
+	void set_scale(const glm::vec2& new_scale) {
+		if (is_valid())
+			Redraw::assign(columns().scale[index()], new_scale);
+	}
+
+	boundary_policy get_boundary() const { return store ? store->get_boundary(id) : boundary_policy::clamp; }
+	void set_boundary(const boundary_policy boundary) {
+		if (store)
+			store->set_boundary(id, boundary);
+	}
+
+	Sprite* get_sprite() const { return has(EntityStore::component_sprite) ? columns().sprite[index()] : nullptr; }
+	void set_sprite(Sprite* spr) {
+		if (store)
+			store->set_sprite(id, spr);
+	}
+
+	primitive_type get_primitive_type() const { return has_shape() ? columns().shapes[index()].type : primitive_type::none; }
+	void set_primitive(const primitive& prim) {
+		if (store)
+			store->set_shape(id, prim);
+	}
+
+	GLboolean get_is_visible() const { return get_flag(EntityStore::flag_visible); }
+	void set_is_visible(const GLboolean is_visible) { set_flag(EntityStore::flag_visible, is_visible); }
+
+	GLboolean get_is_active() const { return get_flag(EntityStore::flag_active); }
+	void set_is_active(const GLboolean is_active) { set_flag(EntityStore::flag_active, is_active); }
+
+	// Set when a kill boundary takes the entity out; see EntityStore::destroy_killed
+	GLboolean get_is_killed() const { return get_flag(EntityStore::flag_killed); }
+
+	unsigned int get_layer() const { return is_valid() ? columns().layer[index()] : 0; }
+	// 0 to RenderQueue::max_layer; larger values are clamped
+	void set_layer(const unsigned int layer) {
+		if (is_valid())
+			Redraw::assign(columns().layer[index()], static_cast<std::uint8_t>(std::min(layer, RenderQueue::max_layer)));
+	}
+
+	GLfloat get_depth() const { return is_valid() ? columns().depth[index()] : 0.0f; }
+	void set_depth(const GLfloat depth) {
+		if (is_valid())
+			Redraw::assign(columns().depth[index()], depth);
+	}
+
+	void store_previous_state() {
+		if (!is_valid())
+			return;
+		columns().previous_position[index()] = columns().position[index()];
+		columns().previous_rotation[index()] = columns().rotation[index()];
+	}
+
+	void reset_previous_state() { store_previous_state(); }
+
+private:
+	// Only for a valid entity
+	EntityStore::archetype& columns() const { return store->archetypes[store->get_location(id).mask]; }
+	std::uint32_t index() const { return store->get_location(id).row; }
+
+	// has() checks the entity is alive
+	bool has(EntityStore::component c) const { return store && store->has(id, c); }
+	bool has_shape() const { return has(EntityStore::component_shape); }
+
+	GLboolean get_flag(std::uint8_t flag) const { return is_valid() && (columns().flags[index()] & flag) != 0; }
+	void set_flag(std::uint8_t flag, GLboolean value) {
+		if (!is_valid())
+			return;
+		std::uint8_t flags = columns().flags[index()];
+		Redraw::assign(columns().flags[index()], static_cast<std::uint8_t>(value ? flags | flag : flags & ~flag));
+	}
+};
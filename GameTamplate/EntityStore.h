@@ -0,0 +1,598 @@
+#pragma once
+#include "Sprite.h"
+#include "Primitives.h"
+#include "RenderQueue.h"
+#include "ViewCulling.h"
+#include "Redraw.h"
+#include "GameObject.h"
+
+#include <cstdint>
+#include <vector>
+
+// Entities stored by archetype instead of one heap object each. An
+// archetype is the set of optional components an entity has (velocity,
+// sprite, shape); every archetype keeps one contiguous column per
+// component, so the update and render systems walk dense arrays and
+// never touch a component an entity does not have.
+//
+// Entities are plain ids: 20 bits of slot index and 12 bits of
+// generation, like Pool handles, so an id kept past destroy() is no
+// longer alive even once its slot is reused. Adding or removing a
+// component moves the entity's row to another archetype; removing an
+// entity swaps the last row into its place. Entity (Entity.h) wraps an id
+// with GameObject-style accessors.
+class EntityStore {
+public:
+	typedef std::uint32_t entity;
+	static const entity null_entity = 0xFFFFFFFF;
+
+	static const std::uint32_t index_bits = 20;
+	// The last index is never used, so null_entity is never alive
+	static const std::uint32_t max_entities = (1u << index_bits) - 1;
+	static const std::uint32_t generation_mask = 0xFFF;
+
+	enum component {
+		component_velocity = 1 << 0,
+		component_sprite = 1 << 1,
+		component_shape = 1 << 2
+	};
+
+	static const int archetype_count = 8;
+
+	// What GameObject keeps in primitive, minus the fields a type doesn't use
+	struct shape {
+		primitive_type type;
+		int segments;
+		glm::vec2 dimensions;
+		glm::vec3 line;
+		glm::vec3 fill;
+	};
+
+private:
+	friend class Entity;
+
+	enum flag {
+		flag_visible = 1 << 0,
+		flag_active = 1 << 1,
+		flag_killed = 1 << 2
+	};
+
+	struct archetype {
+		std::vector<entity> entities;
+
+		// Every archetype
+		std::vector<glm::vec2> position;
+		std::vector<glm::vec2> previous_position;
+		std::vector<float> rotation;
+		std::vector<float> previous_rotation;
+		std::vector<glm::vec2> scale;
+		std::vector<std::uint8_t> flags;
+		std::vector<std::uint8_t> layer;
+		std::vector<float> depth;
+		std::vector<boundary_policy> boundary;
+
+		// Only filled when the archetype has the component
+		std::vector<glm::vec2> velocity;
+		std::vector<Sprite*> sprite;
+		std::vector<shape> shapes;
+	};
+
+	struct location {
+		std::uint8_t mask;
+		std::uint16_t generation;
+		std::uint32_t row;
+	};
+
+	static const std::uint8_t dead_mask = 0xFF;
+
+	archetype archetypes[archetype_count];
+	std::vector<location> locations;
+	std::vector<std::uint32_t> free_indices;
+	std::size_t count;
+
+	// Entities whose boundary is not clamp; while there are none the
+	// update kernel clamps without looking at the boundary column
+	std::size_t special_boundary_count;
+
+	// Scratch for update()
+	std::vector<std::size_t> killed_rows;
+	// Killed since the last destroy_killed()
+	std::vector<entity> killed;
+
+public:
+	EntityStore() : count(0), special_boundary_count(0) {}
+
+	~EntityStore() {
+		clear();
+	}
+
+	EntityStore(const EntityStore&) = delete;
+	EntityStore& operator=(const EntityStore&) = delete;
+
+	// Same three shapes of object the GameObject constructors make. The
+	// sprite is owned by the store from here on, as it is by GameObject.
+	// null_entity once max_entities are alive
+	entity create(const glm::vec2& position, const glm::vec2& velocity = glm::vec2(0.0f)) {
+		unsigned int mask = velocity != glm::vec2(0.0f) ? component_velocity : 0;
+		entity e = allocate(mask, position);
+		if (e != null_entity && (mask & component_velocity))
+			archetypes[mask].velocity.back() = velocity;
+		return e;
+	}
+
+	entity create(const glm::vec2& position, const glm::vec2& velocity, const primitive& prim) {
+		entity e = create(position, velocity);
+		set_shape(e, prim);
+		return e;
+	}
+
+	entity create(const glm::vec2& position, const glm::vec2& velocity, Sprite* sprite) {
+		entity e = create(position, velocity);
+		set_sprite(e, sprite);
+		return e;
+	}
+
+	void destroy(entity e) {
+		if (!is_alive(e))
+			return;
+
+		location& loc = get_location(e);
+		archetype& a = archetypes[loc.mask];
+		if (loc.mask & component_sprite)
+			delete a.sprite[loc.row];
+		if (a.boundary[loc.row] != boundary_policy::clamp)
+			special_boundary_count--;
+
+		remove_row(loc.mask, loc.row);
+		loc.mask = dead_mask;
+		loc.generation = static_cast<std::uint16_t>((loc.generation + 1) & generation_mask);
+		free_indices.push_back(get_index(e));
+		count--;
+		Redraw::mark_dirty();
+	}
+
+	void clear() {
+		for (int mask = 0; mask < archetype_count; mask++) {
+			archetype& a = archetypes[mask];
+			for (Sprite* sprite : a.sprite)
+				delete sprite;
+			a = archetype();
+		}
+		locations.clear();
+		free_indices.clear();
+		killed.clear();
+		count = 0;
+		special_boundary_count = 0;
+	}
+
+	bool is_alive(entity e) const {
+		std::uint32_t index = get_index(e);
+		return index < locations.size() && locations[index].mask != dead_mask
+			&& locations[index].generation == get_generation(e);
+	}
+
+	bool has(entity e, component c) const {
+		return is_alive(e) && (get_location(e).mask & c) != 0;
+	}
+
+	// Components are added by the first set_* call and removed with these
+	void remove_velocity(entity e) {
+		if (has(e, component_velocity))
+			change_mask(e, get_location(e).mask & ~component_velocity);
+	}
+
+	void remove_shape(entity e) {
+		if (has(e, component_shape))
+			change_mask(e, get_location(e).mask & ~component_shape);
+	}
+
+	// Detaches the sprite without deleting it
+	Sprite* release_sprite(entity e) {
+		if (!has(e, component_sprite))
+			return nullptr;
+		Sprite* sprite = archetypes[get_location(e).mask].sprite[get_location(e).row];
+		change_mask(e, get_location(e).mask & ~component_sprite);
+		return sprite;
+	}
+
+	void set_velocity(entity e, const glm::vec2& velocity) {
+		if (!is_alive(e))
+			return;
+		if (!has(e, component_velocity)) {
+			if (velocity == glm::vec2(0.0f))
+				return;
+			change_mask(e, get_location(e).mask | component_velocity);
+		}
+		Redraw::assign(archetypes[get_location(e).mask].velocity[get_location(e).row], velocity);
+	}
+
+	void set_sprite(entity e, Sprite* sprite) {
+		if (!is_alive(e))
+			return;
+		if (!sprite) {
+			release_sprite(e);
+			return;
+		}
+		if (!has(e, component_sprite))
+			change_mask(e, get_location(e).mask | component_sprite);
+		Redraw::assign(archetypes[get_location(e).mask].sprite[get_location(e).row], sprite);
+	}
+
+	void set_boundary(entity e, boundary_policy policy) {
+		if (!is_alive(e))
+			return;
+		boundary_policy& current = archetypes[get_location(e).mask].boundary[get_location(e).row];
+		if (current == boundary_policy::clamp && policy != boundary_policy::clamp)
+			special_boundary_count++;
+		else if (current != boundary_policy::clamp && policy == boundary_policy::clamp)
+			special_boundary_count--;
+		current = policy;
+	}
+
+	boundary_policy get_boundary(entity e) const {
+		return is_alive(e) ? archetypes[get_location(e).mask].boundary[get_location(e).row] : boundary_policy::clamp;
+	}
+
+	void set_shape(entity e, const primitive& prim) {
+		if (!is_alive(e))
+			return;
+		if (prim.type == primitive_type::none) {
+			remove_shape(e);
+			return;
+		}
+		if (!has(e, component_shape))
+			change_mask(e, get_location(e).mask | component_shape);
+
+		shape& s = archetypes[get_location(e).mask].shapes[get_location(e).row];
+		s.type = prim.type;
+		s.segments = prim.type == primitive_type::circle ? prim.segments : 0;
+		s.dimensions = get_dimensions(prim);
+		s.line = prim.line;
+		s.fill = prim.fill;
+		Redraw::mark_dirty();
+	}
+
+	// Systems
+
+	void store_previous_state() {
+		for (int mask = 0; mask < archetype_count; mask++) {
+			archetype& a = archetypes[mask];
+			a.previous_position = a.position;
+			a.previous_rotation = a.rotation;
+		}
+	}
+
+	// GameObject::update for every active entity: animation, movement and
+	// each entity's boundary policy. Entities a kill boundary took out are
+	// flagged killed and made inactive and invisible, like GameObject; the
+	// owner destroys them.
+	void update(float dt, const glm::vec2& bounds_min, const glm::vec2& bounds_max) {
+		bool has_moved = false;
+
+		for (int mask = 0; mask < archetype_count; mask++) {
+			archetype& a = archetypes[mask];
+			std::size_t rows = a.entities.size();
+			if (rows == 0)
+				continue;
+
+			if (mask & component_sprite) {
+				for (std::size_t i = 0; i < rows; i++) {
+					if (a.flags[i] & flag_active)
+						a.sprite[i]->update(dt);
+				}
+			}
+
+			if (mask & component_velocity)
+				has_moved |= integrate(a, dt, bounds_min, bounds_max);
+		}
+
+		if (has_moved)
+			Redraw::mark_dirty();
+	}
+
+	bool is_killed(entity e) const {
+		return is_alive(e) && (archetypes[get_location(e).mask].flags[get_location(e).row] & flag_killed) != 0;
+	}
+
+	// Destroys every entity killed since the last call
+	void destroy_killed() {
+		for (entity e : killed)
+			destroy(e);
+		killed.clear();
+	}
+
+	// GameObject::render(RenderQueue&) for every visible entity in view
+	void record(RenderQueue& queue) const {
+		bool is_culling = ViewCulling::get_is_enabled();
+		float interpolation = GameObject::get_interpolation();
+		unsigned int tested = 0;
+		unsigned int culled = 0;
+
+		for (int mask = 0; mask < archetype_count; mask++) {
+			if (!(mask & (component_sprite | component_shape)))
+				continue;
+
+			const archetype& a = archetypes[mask];
+			std::size_t rows = a.entities.size();
+
+			for (std::size_t i = 0; i < rows; i++) {
+				if (!(a.flags[i] & flag_visible))
+					continue;
+
+				glm::vec2 position = a.position[i];
+				float rotation = a.rotation[i];
+				if (interpolation < 1.0f) {
+					position = glm::mix(a.previous_position[i], position, interpolation);
+					float delta = fmod(rotation - a.previous_rotation[i] + 540.0f, 360.0f) - 180.0f;
+					rotation = a.previous_rotation[i] + delta * interpolation;
+				}
+
+				glm::vec2 corners[4];
+				glm::vec2 min = position;
+				glm::vec2 max = position;
+
+				if (mask & component_sprite) {
+					get_sprite_corners(a.sprite[i]->get_size(), position, rotation, a.scale[i], corners);
+					for (int k = 0; k < 4; k++) {
+						min = glm::min(min, corners[k]);
+						max = glm::max(max, corners[k]);
+					}
+				}
+
+				glm::vec2 shape_scale(0.0f);
+				if (mask & component_shape) {
+					shape_scale = a.scale[i] * a.shapes[i].dimensions;
+					glm::vec2 half_extent = glm::abs(shape_scale);
+					if (a.shapes[i].type != primitive_type::circle)
+						half_extent *= 0.5f;
+
+					float theta = glm::radians(rotation);
+					float c = fabs(cos(theta));
+					float s = fabs(sin(theta));
+					glm::vec2 rotated(c * half_extent.x + s * half_extent.y, s * half_extent.x + c * half_extent.y);
+					min = glm::min(min, position - rotated);
+					max = glm::max(max, position + rotated);
+				}
+
+				if (is_culling) {
+					tested++;
+					if (!ViewCulling::overlaps(min, max)) {
+						culled++;
+						continue;
+					}
+				}
+
+				if (mask & component_sprite) {
+					const Sprite* sprite = a.sprite[i];
+					glm::vec2 tex_coords[4];
+					sprite->get_tex_coords(tex_coords);
+					queue.submit_sprite(a.layer[i], a.depth[i], sprite->get_texture(), sprite->get_is_transparent(),
+						corners, tex_coords, sprite->get_tint());
+				}
+
+				if (mask & component_shape) {
+					const shape& s = a.shapes[i];
+					queue.submit_primitive(a.layer[i], a.depth[i], s.type, s.segments, position, rotation,
+						shape_scale, s.line, s.fill);
+				}
+			}
+		}
+
+		ViewCulling::add_results(tested, culled);
+	}
+
+	std::size_t get_count() const { return count; }
+	// Entities with exactly this combination of components
+	std::size_t get_archetype_size(unsigned int mask) const { return archetypes[mask & 7].entities.size(); }
+
+private:
+	static glm::vec2 get_dimensions(const primitive& prim) {
+		switch (prim.type) {
+		case primitive_type::circle:
+			return glm::vec2(prim.radius);
+		case primitive_type::cube:
+			return glm::vec2(prim.size);
+		case primitive_type::triangle:
+			return glm::vec2(prim.base, prim.height);
+		default:
+			return glm::vec2(0.0f);
+		}
+	}
+
+	// Same corners GameObject::get_sprite_corners produces
+	static void get_sprite_corners(const glm::vec2& size, const glm::vec2& position, float rotation,
+		const glm::vec2& scale, glm::vec2 corners[4]) {
+
+		float theta = glm::radians(rotation);
+		float c = cos(theta);
+		float s = sin(theta);
+
+		const glm::vec2 local[4] = {
+			glm::vec2(0.0f, 0.0f),
+			glm::vec2(size.x, 0.0f),
+			glm::vec2(size.x, size.y),
+			glm::vec2(0.0f, size.y)
+		};
+
+		for (int i = 0; i < 4; i++) {
+			glm::vec2 p = local[i] * scale;
+			corners[i] = position + glm::vec2(p.x * c - p.y * s, p.x * s + p.y * c);
+		}
+	}
+
+	// Boundary::integrate over each run of active rows; inactive rows keep
+	// their position. Killed entities are flagged and added to killed.
+	bool integrate(archetype& a, float dt, const glm::vec2& bounds_min, const glm::vec2& bounds_max) {
+		std::size_t rows = a.entities.size();
+		bool has_moved = false;
+
+		std::size_t first = 0;
+		while (first < rows) {
+			if (!(a.flags[first] & flag_active)) {
+				first++;
+				continue;
+			}
+
+			std::size_t last = first + 1;
+			while (last < rows && (a.flags[last] & flag_active))
+				last++;
+
+			const boundary_policy* policy = special_boundary_count ? &a.boundary[first] : nullptr;
+			killed_rows.clear();
+			has_moved |= Boundary::integrate(&a.position[first], &a.previous_position[first], &a.velocity[first], policy,
+				last - first, dt, bounds_min, bounds_max, killed_rows);
+
+			for (std::size_t row : killed_rows) {
+				a.flags[first + row] = flag_killed;
+				killed.push_back(a.entities[first + row]);
+			}
+
+			first = last;
+		}
+
+		return has_moved;
+	}
+
+	static std::uint32_t get_index(entity e) { return e & ((1u << index_bits) - 1); }
+	static std::uint32_t get_generation(entity e) { return e >> index_bits; }
+
+	location& get_location(entity e) { return locations[get_index(e)]; }
+	const location& get_location(entity e) const { return locations[get_index(e)]; }
+
+	entity allocate(unsigned int mask, const glm::vec2& position) {
+		std::uint32_t index;
+		if (!free_indices.empty()) {
+			index = free_indices.back();
+			free_indices.pop_back();
+		}
+		else {
+			if (locations.size() >= max_entities)
+				return null_entity;
+			index = static_cast<std::uint32_t>(locations.size());
+			location loc = { dead_mask, 0, 0 };
+			locations.push_back(loc);
+		}
+
+		archetype& a = archetypes[mask];
+		location& loc = locations[index];
+		loc.mask = static_cast<std::uint8_t>(mask);
+		loc.row = static_cast<std::uint32_t>(a.entities.size());
+		entity e = (static_cast<std::uint32_t>(loc.generation) << index_bits) | index;
+
+		a.entities.push_back(e);
+		a.position.push_back(position);
+		a.previous_position.push_back(position);
+		a.rotation.push_back(0.0f);
+		a.previous_rotation.push_back(0.0f);
+		a.scale.push_back(glm::vec2(1.0f));
+		a.flags.push_back(flag_visible | flag_active);
+		a.layer.push_back(0);
+		a.depth.push_back(0.0f);
+		a.boundary.push_back(boundary_policy::clamp);
+		push_optional(a, mask);
+
+		count++;
+		Redraw::mark_dirty();
+		return e;
+	}
+
+	static void push_optional(archetype& a, unsigned int mask) {
+		if (mask & component_velocity)
+			a.velocity.push_back(glm::vec2(0.0f));
+		if (mask & component_sprite)
+			a.sprite.push_back(nullptr);
+		if (mask & component_shape) {
+			shape s = { primitive_type::none, 0, glm::vec2(0.0f), glm::vec3(0.0f), glm::vec3(0.0f) };
+			a.shapes.push_back(s);
+		}
+	}
+
+	// Moves the entity's row to the archetype for new_mask, keeping the
+	// components both have
+	void change_mask(entity e, unsigned int new_mask) {
+		if (!is_alive(e) || get_location(e).mask == new_mask)
+			return;
+
+		location old = get_location(e);
+		archetype& from = archetypes[old.mask];
+		archetype& to = archetypes[new_mask];
+		std::uint32_t row = old.row;
+
+		to.entities.push_back(e);
+		to.position.push_back(from.position[row]);
+		to.previous_position.push_back(from.previous_position[row]);
+		to.rotation.push_back(from.rotation[row]);
+		to.previous_rotation.push_back(from.previous_rotation[row]);
+		to.scale.push_back(from.scale[row]);
+		to.flags.push_back(from.flags[row]);
+		to.layer.push_back(from.layer[row]);
+		to.depth.push_back(from.depth[row]);
+		to.boundary.push_back(from.boundary[row]);
+		push_optional(to, new_mask);
+
+		std::size_t new_row = to.entities.size() - 1;
+		if (new_mask & old.mask & component_velocity)
+			to.velocity[new_row] = from.velocity[row];
+		if (new_mask & old.mask & component_sprite)
+			to.sprite[new_row] = from.sprite[row];
+		if (new_mask & old.mask & component_shape)
+			to.shapes[new_row] = from.shapes[row];
+
+		remove_row(old.mask, row);
+
+		get_location(e).mask = static_cast<std::uint8_t>(new_mask);
+		get_location(e).row = static_cast<std::uint32_t>(new_row);
+		Redraw::mark_dirty();
+	}
+
+	// Swap-remove, fixing up the location of the row that moved
+	void remove_row(unsigned int mask, std::uint32_t row) {
+		archetype& a = archetypes[mask];
+		std::size_t last = a.entities.size() - 1;
+
+		if (row != last) {
+			a.entities[row] = a.entities[last];
+			a.position[row] = a.position[last];
+			a.previous_position[row] = a.previous_position[last];
+			a.rotation[row] = a.rotation[last];
+			a.previous_rotation[row] = a.previous_rotation[last];
+			a.scale[row] = a.scale[last];
+			a.flags[row] = a.flags[last];
+			a.layer[row] = a.layer[last];
+			a.depth[row] = a.depth[last];
+			a.boundary[row] = a.boundary[last];
+			if (mask & component_velocity)
+				a.velocity[row] = a.velocity[last];
+			if (mask & component_sprite)
+				a.sprite[row] = a.sprite[last];
+			if (mask & component_shape)
+				a.shapes[row] = a.shapes[last];
+
+			locations[get_index(a.entities[row])].row = row;
+		}
+
+		a.entities.pop_back();
+		a.position.pop_back();
+		a.previous_position.pop_back();
+		a.rotation.pop_back();
+		a.previous_rotation.pop_back();
+		a.scale.pop_back();
+		a.flags.pop_back();
+		a.layer.pop_back();
+		a.depth.pop_back();
+		a.boundary.pop_back();
+		if (mask & component_velocity)
+			a.velocity.pop_back();
+		if (mask & component_sprite)
+			a.sprite.pop_back();
+		if (mask & component_shape)
+			a.shapes.pop_back();
+	}
+};
+
+const EntityStore::entity EntityStore::null_entity;
+const std::uint32_t EntityStore::index_bits;
+const std::uint32_t EntityStore::max_entities;
+const std::uint32_t EntityStore::generation_mask;
+const int EntityStore::archetype_count;
+const std::uint8_t EntityStore::dead_mask;
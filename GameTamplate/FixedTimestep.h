@@ -0,0 +1,63 @@
+#pragma once
+#include <chrono>
+
+// Runs the simulation at a fixed rate no matter how often frames are
+// drawn. Each frame advance() reads a monotonic clock and says how many
+// steps of get_step() seconds to run; get_alpha() is how far the frame is
+// into the next step, which is what rendering interpolates with.
+class FixedTimestep {
+public:
+	typedef std::chrono::steady_clock clock;
+
+private:
+	double step;
+	double accumulator;
+	int max_steps;
+
+	clock::time_point previous_time;
+	bool is_started;
+
+	int steps_dropped;
+
+public:
+	FixedTimestep(double steps_per_second = 60.0, int max_steps = 8)
+		: step(1.0 / steps_per_second), accumulator(0.0), max_steps(max_steps),
+		is_started(false), steps_dropped(0) {}
+
+	// Steps to run this frame. When the game falls too far behind, the
+	// extra time is dropped instead of piling up more and more steps.
+	int advance() {
+		clock::time_point now = clock::now();
+		if (!is_started) {
+			previous_time = now;
+			is_started = true;
+		}
+
+		accumulator += std::chrono::duration<double>(now - previous_time).count();
+		previous_time = now;
+
+		int steps = static_cast<int>(accumulator / step);
+		if (steps > max_steps) {
+			steps_dropped += steps - max_steps;
+			accumulator -= (steps - max_steps) * step;
+			steps = max_steps;
+		}
+
+		accumulator -= steps * step;
+		return steps;
+	}
+
+	// Forget the time spent since the last advance(), e.g. after a pause
+	void reset() { is_started = false; accumulator = 0.0; }
+
+	float get_step() const { return static_cast<float>(step); }
+	void set_steps_per_second(double steps_per_second) { step = 1.0 / steps_per_second; }
+
+	float get_alpha() const { return static_cast<float>(accumulator / step); }
+
+	int get_max_steps() const { return max_steps; }
+	void set_max_steps(const int max_steps) { this->max_steps = max_steps; }
+
+	// Steps skipped so far because a frame took too long
+	int get_steps_dropped() const { return steps_dropped; }
+};
@@ -0,0 +1,94 @@
+#pragma once
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+// Caps the frame rate by sleeping until the next frame is due, so an idle
+// game leaves the CPU alone. Most of the wait is a real sleep; the last
+// stretch, where the OS scheduler is too coarse, is spent yielding.
+class FrameLimiter {
+public:
+	typedef std::chrono::steady_clock clock;
+
+private:
+	clock::duration frame_time;
+	clock::duration spin_time;
+	clock::time_point next_frame;
+	bool is_started;
+
+	double last_sleep;
+
+public:
+	// frames_per_second 0 means no limit
+	FrameLimiter(double frames_per_second = 60.0)
+		: spin_time(std::chrono::milliseconds(1)), is_started(false), last_sleep(0.0) {
+
+		set_frames_per_second(frames_per_second);
+#ifdef _WIN32
+		// Default timer resolution is ~15 ms, too coarse to hit a 16.6 ms frame
+		timeBeginPeriod(1);
+#endif
+	}
+
+	~FrameLimiter() {
+#ifdef _WIN32
+		timeEndPeriod(1);
+#endif
+	}
+
+	FrameLimiter(const FrameLimiter&) = delete;
+	FrameLimiter& operator=(const FrameLimiter&) = delete;
+
+	// Call once per frame after rendering
+	void wait() {
+		clock::time_point now = clock::now();
+		last_sleep = 0.0;
+
+		if (frame_time == clock::duration::zero())
+			return;
+
+		if (!is_started) {
+			next_frame = now;
+			is_started = true;
+		}
+
+		next_frame += frame_time;
+
+		// Already late: start counting from now instead of rushing to catch up
+		if (now > next_frame) {
+			next_frame = now;
+			return;
+		}
+
+		clock::time_point start = now;
+
+		if (next_frame - now > spin_time)
+			std::this_thread::sleep_for(next_frame - now - spin_time);
+
+		while (clock::now() < next_frame)
+			std::this_thread::yield();
+
+		last_sleep = std::chrono::duration<double>(clock::now() - start).count();
+	}
+
+	void set_frames_per_second(double frames_per_second) {
+		if (frames_per_second > 0.0)
+			frame_time = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / frames_per_second));
+		else
+			frame_time = clock::duration::zero();
+		is_started = false;
+	}
+
+	double get_frames_per_second() const {
+		double seconds = std::chrono::duration<double>(frame_time).count();
+		return seconds > 0.0 ? 1.0 / seconds : 0.0;
+	}
+
+	// Seconds the last wait() spent sleeping or yielding
+	double get_last_sleep() const { return last_sleep; }
+};
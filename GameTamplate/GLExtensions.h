@@ -0,0 +1,329 @@
+#pragma once
+#include <freeglut.h>
+
+#include <cstddef>
+#include <cstdio>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+// Windows gl.h stops at OpenGL 1.1, so everything newer is declared here
+// and resolved at runtime through glutGetProcAddress.
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef GL_DYNAMIC_DRAW
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER 0x8B31
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT 0x0004
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_WAIT_FAILED 0x911D
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+
+class GLExtensions {
+public:
+	typedef void (APIENTRY* gen_buffers_proc)(GLsizei n, GLuint* buffers);
+	typedef void (APIENTRY* delete_buffers_proc)(GLsizei n, const GLuint* buffers);
+	typedef void (APIENTRY* bind_buffer_proc)(GLenum target, GLuint buffer);
+	typedef void (APIENTRY* buffer_data_proc)(GLenum target, std::ptrdiff_t size, const void* data, GLenum usage);
+	typedef void (APIENTRY* buffer_sub_data_proc)(GLenum target, std::ptrdiff_t offset, std::ptrdiff_t size, const void* data);
+
+	typedef GLuint(APIENTRY* create_shader_proc)(GLenum type);
+	typedef void (APIENTRY* delete_shader_proc)(GLuint shader);
+	typedef void (APIENTRY* shader_source_proc)(GLuint shader, GLsizei count, const char* const* string, const GLint* length);
+	typedef void (APIENTRY* compile_shader_proc)(GLuint shader);
+	typedef void (APIENTRY* get_shader_iv_proc)(GLuint shader, GLenum pname, GLint* params);
+	typedef void (APIENTRY* get_shader_info_log_proc)(GLuint shader, GLsizei max_length, GLsizei* length, char* info_log);
+	typedef GLuint(APIENTRY* create_program_proc)();
+	typedef void (APIENTRY* delete_program_proc)(GLuint program);
+	typedef void (APIENTRY* attach_shader_proc)(GLuint program, GLuint shader);
+	typedef void (APIENTRY* bind_attrib_location_proc)(GLuint program, GLuint index, const char* name);
+	typedef void (APIENTRY* link_program_proc)(GLuint program);
+	typedef void (APIENTRY* get_program_iv_proc)(GLuint program, GLenum pname, GLint* params);
+	typedef void (APIENTRY* get_program_info_log_proc)(GLuint program, GLsizei max_length, GLsizei* length, char* info_log);
+	typedef void (APIENTRY* use_program_proc)(GLuint program);
+	typedef GLint(APIENTRY* get_uniform_location_proc)(GLuint program, const char* name);
+	typedef void (APIENTRY* uniform_1i_proc)(GLint location, GLint v0);
+	typedef void (APIENTRY* enable_vertex_attrib_array_proc)(GLuint index);
+	typedef void (APIENTRY* disable_vertex_attrib_array_proc)(GLuint index);
+	typedef void (APIENTRY* vertex_attrib_pointer_proc)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
+	typedef void (APIENTRY* vertex_attrib_divisor_proc)(GLuint index, GLuint divisor);
+	typedef void (APIENTRY* draw_arrays_instanced_proc)(GLenum mode, GLint first, GLsizei count, GLsizei instance_count);
+
+	typedef void (APIENTRY* gen_framebuffers_proc)(GLsizei n, GLuint* framebuffers);
+	typedef void (APIENTRY* delete_framebuffers_proc)(GLsizei n, const GLuint* framebuffers);
+	typedef void (APIENTRY* bind_framebuffer_proc)(GLenum target, GLuint framebuffer);
+	typedef void (APIENTRY* framebuffer_texture_2d_proc)(GLenum target, GLenum attachment, GLenum texture_target, GLuint texture, GLint level);
+	typedef GLenum(APIENTRY* check_framebuffer_status_proc)(GLenum target);
+
+	// GLsync is an opaque pointer; void* keeps this independent of gl.h's version
+	typedef void* sync_handle;
+	typedef void* (APIENTRY* map_buffer_range_proc)(GLenum target, std::ptrdiff_t offset, std::ptrdiff_t length, GLbitfield access);
+	typedef GLboolean(APIENTRY* unmap_buffer_proc)(GLenum target);
+	typedef void (APIENTRY* buffer_storage_proc)(GLenum target, std::ptrdiff_t size, const void* data, GLbitfield flags);
+	typedef sync_handle(APIENTRY* fence_sync_proc)(GLenum condition, GLbitfield flags);
+	typedef GLenum(APIENTRY* client_wait_sync_proc)(sync_handle sync, GLbitfield flags, unsigned long long timeout);
+	typedef void (APIENTRY* delete_sync_proc)(sync_handle sync);
+
+	typedef void (APIENTRY* blend_func_separate_proc)(GLenum source_rgb, GLenum destination_rgb, GLenum source_alpha, GLenum destination_alpha);
+
+	static gen_buffers_proc gen_buffers;
+	static delete_buffers_proc delete_buffers;
+	static bind_buffer_proc bind_buffer;
+	static buffer_data_proc buffer_data;
+	static buffer_sub_data_proc buffer_sub_data;
+
+	static create_shader_proc create_shader;
+	static delete_shader_proc delete_shader;
+	static shader_source_proc shader_source;
+	static compile_shader_proc compile_shader;
+	static get_shader_iv_proc get_shader_iv;
+	static get_shader_info_log_proc get_shader_info_log;
+	static create_program_proc create_program;
+	static delete_program_proc delete_program;
+	static attach_shader_proc attach_shader;
+	static bind_attrib_location_proc bind_attrib_location;
+	static link_program_proc link_program;
+	static get_program_iv_proc get_program_iv;
+	static get_program_info_log_proc get_program_info_log;
+	static use_program_proc use_program;
+	static get_uniform_location_proc get_uniform_location;
+	static uniform_1i_proc uniform_1i;
+	static enable_vertex_attrib_array_proc enable_vertex_attrib_array;
+	static disable_vertex_attrib_array_proc disable_vertex_attrib_array;
+	static vertex_attrib_pointer_proc vertex_attrib_pointer;
+	static vertex_attrib_divisor_proc vertex_attrib_divisor;
+	static draw_arrays_instanced_proc draw_arrays_instanced;
+
+	static gen_framebuffers_proc gen_framebuffers;
+	static delete_framebuffers_proc delete_framebuffers;
+	static bind_framebuffer_proc bind_framebuffer;
+	static framebuffer_texture_2d_proc framebuffer_texture_2d;
+	static check_framebuffer_status_proc check_framebuffer_status;
+
+	static map_buffer_range_proc map_buffer_range;
+	static unmap_buffer_proc unmap_buffer;
+	static buffer_storage_proc buffer_storage;
+	static fence_sync_proc fence_sync;
+	static client_wait_sync_proc client_wait_sync;
+	static delete_sync_proc delete_sync;
+
+	static blend_func_separate_proc blend_func_separate;
+
+private:
+	static bool is_loaded;
+	static int major_version;
+	static int minor_version;
+
+	template <typename T>
+	static T get_proc(const char* name) {
+		return reinterpret_cast<T>(glutGetProcAddress(name));
+	}
+
+public:
+	// Needs a current context, so call it after glutCreateWindow.
+	static void load();
+
+	static bool has_version(int major, int minor);
+
+	static bool has_vertex_buffers();
+	static bool has_shaders();
+	static bool has_instancing();
+	static bool has_framebuffers();
+	static bool has_map_buffer_range();
+	static bool has_sync();
+	static bool has_buffer_storage();
+	static bool has_blend_func_separate();
+};
+
+GLExtensions::gen_buffers_proc GLExtensions::gen_buffers = nullptr;
+GLExtensions::delete_buffers_proc GLExtensions::delete_buffers = nullptr;
+GLExtensions::bind_buffer_proc GLExtensions::bind_buffer = nullptr;
+GLExtensions::buffer_data_proc GLExtensions::buffer_data = nullptr;
+GLExtensions::buffer_sub_data_proc GLExtensions::buffer_sub_data = nullptr;
+
+GLExtensions::create_shader_proc GLExtensions::create_shader = nullptr;
+GLExtensions::delete_shader_proc GLExtensions::delete_shader = nullptr;
+GLExtensions::shader_source_proc GLExtensions::shader_source = nullptr;
+GLExtensions::compile_shader_proc GLExtensions::compile_shader = nullptr;
+GLExtensions::get_shader_iv_proc GLExtensions::get_shader_iv = nullptr;
+GLExtensions::get_shader_info_log_proc GLExtensions::get_shader_info_log = nullptr;
+GLExtensions::create_program_proc GLExtensions::create_program = nullptr;
+GLExtensions::delete_program_proc GLExtensions::delete_program = nullptr;
+GLExtensions::attach_shader_proc GLExtensions::attach_shader = nullptr;
+GLExtensions::bind_attrib_location_proc GLExtensions::bind_attrib_location = nullptr;
+GLExtensions::link_program_proc GLExtensions::link_program = nullptr;
+GLExtensions::get_program_iv_proc GLExtensions::get_program_iv = nullptr;
+GLExtensions::get_program_info_log_proc GLExtensions::get_program_info_log = nullptr;
+GLExtensions::use_program_proc GLExtensions::use_program = nullptr;
+GLExtensions::get_uniform_location_proc GLExtensions::get_uniform_location = nullptr;
+GLExtensions::uniform_1i_proc GLExtensions::uniform_1i = nullptr;
+GLExtensions::enable_vertex_attrib_array_proc GLExtensions::enable_vertex_attrib_array = nullptr;
+GLExtensions::disable_vertex_attrib_array_proc GLExtensions::disable_vertex_attrib_array = nullptr;
+GLExtensions::vertex_attrib_pointer_proc GLExtensions::vertex_attrib_pointer = nullptr;
+GLExtensions::vertex_attrib_divisor_proc GLExtensions::vertex_attrib_divisor = nullptr;
+GLExtensions::draw_arrays_instanced_proc GLExtensions::draw_arrays_instanced = nullptr;
+
+GLExtensions::gen_framebuffers_proc GLExtensions::gen_framebuffers = nullptr;
+GLExtensions::delete_framebuffers_proc GLExtensions::delete_framebuffers = nullptr;
+GLExtensions::bind_framebuffer_proc GLExtensions::bind_framebuffer = nullptr;
+GLExtensions::framebuffer_texture_2d_proc GLExtensions::framebuffer_texture_2d = nullptr;
+GLExtensions::check_framebuffer_status_proc GLExtensions::check_framebuffer_status = nullptr;
+
+GLExtensions::map_buffer_range_proc GLExtensions::map_buffer_range = nullptr;
+GLExtensions::unmap_buffer_proc GLExtensions::unmap_buffer = nullptr;
+GLExtensions::buffer_storage_proc GLExtensions::buffer_storage = nullptr;
+GLExtensions::fence_sync_proc GLExtensions::fence_sync = nullptr;
+GLExtensions::client_wait_sync_proc GLExtensions::client_wait_sync = nullptr;
+GLExtensions::delete_sync_proc GLExtensions::delete_sync = nullptr;
+
+GLExtensions::blend_func_separate_proc GLExtensions::blend_func_separate = nullptr;
+
+bool GLExtensions::is_loaded = false;
+int GLExtensions::major_version = 1;
+int GLExtensions::minor_version = 0;
+
+void GLExtensions::load() {
+	if (is_loaded)
+		return;
+
+	gen_buffers = get_proc<gen_buffers_proc>("glGenBuffers");
+	delete_buffers = get_proc<delete_buffers_proc>("glDeleteBuffers");
+	bind_buffer = get_proc<bind_buffer_proc>("glBindBuffer");
+	buffer_data = get_proc<buffer_data_proc>("glBufferData");
+	buffer_sub_data = get_proc<buffer_sub_data_proc>("glBufferSubData");
+
+	create_shader = get_proc<create_shader_proc>("glCreateShader");
+	delete_shader = get_proc<delete_shader_proc>("glDeleteShader");
+	shader_source = get_proc<shader_source_proc>("glShaderSource");
+	compile_shader = get_proc<compile_shader_proc>("glCompileShader");
+	get_shader_iv = get_proc<get_shader_iv_proc>("glGetShaderiv");
+	get_shader_info_log = get_proc<get_shader_info_log_proc>("glGetShaderInfoLog");
+	create_program = get_proc<create_program_proc>("glCreateProgram");
+	delete_program = get_proc<delete_program_proc>("glDeleteProgram");
+	attach_shader = get_proc<attach_shader_proc>("glAttachShader");
+	bind_attrib_location = get_proc<bind_attrib_location_proc>("glBindAttribLocation");
+	link_program = get_proc<link_program_proc>("glLinkProgram");
+	get_program_iv = get_proc<get_program_iv_proc>("glGetProgramiv");
+	get_program_info_log = get_proc<get_program_info_log_proc>("glGetProgramInfoLog");
+	use_program = get_proc<use_program_proc>("glUseProgram");
+	get_uniform_location = get_proc<get_uniform_location_proc>("glGetUniformLocation");
+	uniform_1i = get_proc<uniform_1i_proc>("glUniform1i");
+	enable_vertex_attrib_array = get_proc<enable_vertex_attrib_array_proc>("glEnableVertexAttribArray");
+	disable_vertex_attrib_array = get_proc<disable_vertex_attrib_array_proc>("glDisableVertexAttribArray");
+	vertex_attrib_pointer = get_proc<vertex_attrib_pointer_proc>("glVertexAttribPointer");
+	vertex_attrib_divisor = get_proc<vertex_attrib_divisor_proc>("glVertexAttribDivisor");
+	draw_arrays_instanced = get_proc<draw_arrays_instanced_proc>("glDrawArraysInstanced");
+
+	gen_framebuffers = get_proc<gen_framebuffers_proc>("glGenFramebuffers");
+	delete_framebuffers = get_proc<delete_framebuffers_proc>("glDeleteFramebuffers");
+	bind_framebuffer = get_proc<bind_framebuffer_proc>("glBindFramebuffer");
+	framebuffer_texture_2d = get_proc<framebuffer_texture_2d_proc>("glFramebufferTexture2D");
+	check_framebuffer_status = get_proc<check_framebuffer_status_proc>("glCheckFramebufferStatus");
+
+	map_buffer_range = get_proc<map_buffer_range_proc>("glMapBufferRange");
+	unmap_buffer = get_proc<unmap_buffer_proc>("glUnmapBuffer");
+	buffer_storage = get_proc<buffer_storage_proc>("glBufferStorage");
+	fence_sync = get_proc<fence_sync_proc>("glFenceSync");
+	client_wait_sync = get_proc<client_wait_sync_proc>("glClientWaitSync");
+	delete_sync = get_proc<delete_sync_proc>("glDeleteSync");
+
+	blend_func_separate = get_proc<blend_func_separate_proc>("glBlendFuncSeparate");
+
+	// GLX hands out addresses even for functions the driver lacks, so the
+	// version string is what decides which paths are usable.
+	const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+	if (version == nullptr || sscanf(version, "%d.%d", &major_version, &minor_version) != 2) {
+		major_version = 1;
+		minor_version = 0;
+	}
+
+	is_loaded = true;
+}
+
+bool GLExtensions::has_version(int major, int minor) {
+	return major_version > major || (major_version == major && minor_version >= minor);
+}
+
+bool GLExtensions::has_vertex_buffers() {
+	return has_version(1, 5) &&
+		gen_buffers && delete_buffers && bind_buffer && buffer_data && buffer_sub_data;
+}
+
+bool GLExtensions::has_shaders() {
+	return has_version(2, 0) &&
+		create_shader && delete_shader && shader_source && compile_shader && get_shader_iv && get_shader_info_log &&
+		create_program && delete_program && attach_shader && bind_attrib_location && link_program &&
+		get_program_iv && get_program_info_log && use_program && get_uniform_location && uniform_1i &&
+		enable_vertex_attrib_array && disable_vertex_attrib_array && vertex_attrib_pointer;
+}
+
+bool GLExtensions::has_instancing() {
+	return has_version(3, 3) && has_vertex_buffers() && has_shaders() &&
+		vertex_attrib_divisor && draw_arrays_instanced;
+}
+
+bool GLExtensions::has_framebuffers() {
+	return has_version(3, 0) &&
+		gen_framebuffers && delete_framebuffers && bind_framebuffer && framebuffer_texture_2d && check_framebuffer_status;
+}
+
+bool GLExtensions::has_map_buffer_range() {
+	return has_version(3, 0) && has_vertex_buffers() && map_buffer_range && unmap_buffer;
+}
+
+bool GLExtensions::has_sync() {
+	return has_version(3, 2) && fence_sync && client_wait_sync && delete_sync;
+}
+
+bool GLExtensions::has_buffer_storage() {
+	return has_version(4, 4) && has_map_buffer_range() && has_sync() && buffer_storage;
+}
+
+bool GLExtensions::has_blend_func_separate() {
+	return has_version(1, 4) && blend_func_separate;
+}
@@ -0,0 +1,209 @@
+#pragma once
+#include <freeglut.h>
+#include <glm.hpp>
+
+#include "GLExtensions.h"
+
+// Shadow copy of the GL state GameTamplate touches. Every change goes
+// through here and is dropped when it would not change anything.
+class GLState {
+private:
+	enum tracked_capability {
+		texture_2d,
+		blend,
+		capability_count
+	};
+
+	// -1 means unknown, so the first call always reaches GL
+	static int capabilities[capability_count];
+
+	static GLuint bound_texture;
+	static bool is_texture_known;
+
+	static GLenum blend_source;
+	static GLenum blend_destination;
+	static bool is_blend_func_known;
+	static bool is_accumulating_alpha;
+
+	static GLfloat line_width;
+	static bool is_line_width_known;
+
+	static glm::vec4 color;
+	static bool is_color_known;
+
+	static GLuint window_framebuffer;
+
+	static unsigned int changes_issued;
+	static unsigned int changes_filtered;
+
+public:
+	static void enable(GLenum capability);
+	static void disable(GLenum capability);
+	static void bind_texture(GLuint texture);
+	static void blend_func(GLenum source, GLenum destination);
+	// While on, every blend_func() blends alpha as GL_ONE,
+	// GL_ONE_MINUS_SRC_ALPHA whatever it does to the colors, so a texture
+	// drawn into from transparent black ends up with the coverage as alpha
+	// rather than alpha squared. Needs glBlendFuncSeparate; ignored without.
+	static void set_accumulate_alpha(bool enabled);
+	static void set_line_width(GLfloat width);
+	static void set_color(GLfloat r, GLfloat g, GLfloat b, GLfloat a = 1.0f);
+
+	// Forget everything, e.g. after code outside GameTamplate touched GL
+	static void invalidate();
+	// Vertex color arrays leave the current color undefined
+	static void invalidate_color() { is_color_known = false; }
+
+	static void begin_frame();
+
+	// Framebuffer that stands in for the window, 0 unless rendering offscreen.
+	// Code that redirects rendering binds this instead of 0 when it is done.
+	static GLuint get_window_framebuffer() { return window_framebuffer; }
+	static void set_window_framebuffer(GLuint framebuffer) { window_framebuffer = framebuffer; }
+
+	static unsigned int get_changes_issued() { return changes_issued; }
+	static unsigned int get_changes_filtered() { return changes_filtered; }
+
+private:
+	static int get_tracked_index(GLenum capability);
+	static void set_capability(GLenum capability, bool enabled);
+};
+
+int GLState::capabilities[GLState::capability_count] = { -1, -1 };
+
+GLuint GLState::bound_texture = 0;
+bool GLState::is_texture_known = false;
+
+GLenum GLState::blend_source = GL_ONE;
+GLenum GLState::blend_destination = GL_ZERO;
+bool GLState::is_blend_func_known = false;
+bool GLState::is_accumulating_alpha = false;
+
+GLfloat GLState::line_width = 1.0f;
+bool GLState::is_line_width_known = false;
+
+glm::vec4 GLState::color = glm::vec4(1.0f);
+bool GLState::is_color_known = false;
+
+GLuint GLState::window_framebuffer = 0;
+
+unsigned int GLState::changes_issued = 0;
+unsigned int GLState::changes_filtered = 0;
+
+void GLState::enable(GLenum capability) {
+	set_capability(capability, true);
+}
+
+void GLState::disable(GLenum capability) {
+	set_capability(capability, false);
+}
+
+void GLState::bind_texture(GLuint texture) {
+	if (is_texture_known && bound_texture == texture) {
+		changes_filtered++;
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	bound_texture = texture;
+	is_texture_known = true;
+	changes_issued++;
+}
+
+void GLState::blend_func(GLenum source, GLenum destination) {
+	if (is_blend_func_known && blend_source == source && blend_destination == destination) {
+		changes_filtered++;
+		return;
+	}
+
+	if (is_accumulating_alpha)
+		GLExtensions::blend_func_separate(source, destination, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	else
+		glBlendFunc(source, destination);
+	blend_source = source;
+	blend_destination = destination;
+	is_blend_func_known = true;
+	changes_issued++;
+}
+
+void GLState::set_accumulate_alpha(bool enabled) {
+	enabled = enabled && GLExtensions::has_blend_func_separate();
+	if (is_accumulating_alpha == enabled)
+		return;
+
+	is_accumulating_alpha = enabled;
+	if (is_blend_func_known) {
+		// Reissue the current function in the new mode
+		is_blend_func_known = false;
+		blend_func(blend_source, blend_destination);
+	}
+}
+
+void GLState::set_line_width(GLfloat width) {
+	if (is_line_width_known && line_width == width) {
+		changes_filtered++;
+		return;
+	}
+
+	glLineWidth(width);
+	line_width = width;
+	is_line_width_known = true;
+	changes_issued++;
+}
+
+void GLState::set_color(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+	glm::vec4 new_color(r, g, b, a);
+	if (is_color_known && color == new_color) {
+		changes_filtered++;
+		return;
+	}
+
+	glColor4f(r, g, b, a);
+	color = new_color;
+	is_color_known = true;
+	changes_issued++;
+}
+
+void GLState::invalidate() {
+	for (int i = 0; i < capability_count; i++)
+		capabilities[i] = -1;
+
+	is_texture_known = false;
+	is_blend_func_known = false;
+	is_line_width_known = false;
+	is_color_known = false;
+}
+
+void GLState::begin_frame() {
+	changes_issued = 0;
+	changes_filtered = 0;
+}
+
+int GLState::get_tracked_index(GLenum capability) {
+	switch (capability) {
+	case GL_TEXTURE_2D:
+		return texture_2d;
+	case GL_BLEND:
+		return blend;
+	default:
+		return -1;
+	}
+}
+
+void GLState::set_capability(GLenum capability, bool enabled) {
+	int index = get_tracked_index(capability);
+
+	if (index >= 0) {
+		if (capabilities[index] == static_cast<int>(enabled)) {
+			changes_filtered++;
+			return;
+		}
+		capabilities[index] = static_cast<int>(enabled);
+	}
+
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+	changes_issued++;
+}
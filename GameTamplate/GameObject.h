@@ -1,192 +1,525 @@
 #pragma once
 #include "Sprite.h"
 #include "Primitives.h"
+#include "RenderQueue.h"
+#include "ViewCulling.h"
+#include "Boundary.h"
+#include "Transform2D.h"
+
+#include <algorithm>
+#include <vector>
 
 #include <gtc/type_ptr.hpp>
 #include <gtc/matrix_transform.hpp>
 
 class GameObject {
 private:
+	// Relative to the parent, if there is one
 	glm::vec2 position;
 	float rotation;
 	glm::vec2 scale;
 
+	GameObject* parent;
+	std::vector<GameObject*> children;
+
+	// World transform as drawn, see update_transform(). Rebuilt only when
+	// the local transform differs from the cached one or the parent's
+	// world_version moved on, so unchanged subtrees cost a few compares.
+	glm::mat3 world_matrix;
+	glm::vec2 cached_position;
+	float cached_rotation;
+	glm::vec2 cached_scale;
+	unsigned int world_version;
+	unsigned int parent_version;
+	bool is_transform_dirty;
+
+	// Transform at the start of the current simulation step
+	glm::vec2 previous_position;
+	float previous_rotation;
+
+	// How far rendering is between the previous and the current step
+	static float interpolation;
+
 	primitive primitive;
 	Sprite* sprite;
+	GLboolean owns_sprite;
 
 	glm::vec2 velocity;
+	boundary_policy boundary;
 
 	GLboolean is_visible;
 	GLboolean is_active;
+	GLboolean is_killed;
+
+	unsigned int layer;
+	GLfloat depth;
 public:
 	GameObject()
-		: position(0.0f, 0.0f), velocity(0.0f, 0.0f),
-		rotation(0.0f), scale(1.0f, 1.0f), primitive(), sprite(), is_visible(true), is_active(true) {}
+		: position(0.0f, 0.0f), rotation(0.0f), scale(1.0f, 1.0f),
+		parent(), world_matrix(1.0f), cached_rotation(0.0f), world_version(0), parent_version(0), is_transform_dirty(true),
+		previous_position(0.0f, 0.0f), previous_rotation(0.0f),
+		primitive(), sprite(), owns_sprite(true), velocity(0.0f, 0.0f),
+		boundary(boundary_policy::clamp), is_visible(true), is_active(true), is_killed(false), layer(0), depth(0.0f) {}
 
 	GameObject(const glm::vec2& pos, const glm::vec2& vel, const struct primitive& prim)
-		: position(pos), velocity(vel), rotation(0.0f), scale(1.0f, 1.0f),
-		primitive(prim), sprite(), is_visible(true), is_active(true) {}
-
-	GameObject(const glm::vec2& pos, const glm::vec2& vel, Sprite* spr)
-		: position(pos), velocity(vel), rotation(0.0f), scale(1.0f, 1.0f),
-		sprite(spr), is_visible(true), is_active(true) {}
-
+		: position(pos), rotation(0.0f), scale(1.0f, 1.0f),
+		parent(), world_matrix(1.0f), cached_rotation(0.0f), world_version(0), parent_version(0), is_transform_dirty(true),
+		previous_position(pos), previous_rotation(0.0f),
+		primitive(prim), sprite(), owns_sprite(true), velocity(vel),
+		boundary(boundary_policy::clamp), is_visible(true), is_active(true), is_killed(false), layer(0), depth(0.0f) {}
+
+	// owns_sprite false for a sprite kept elsewhere, such as a Pool<Sprite>,
+	// so it is not deleted along with the object
+	GameObject(const glm::vec2& pos, const glm::vec2& vel, Sprite* spr, GLboolean owns_sprite = true)
+		: position(pos), rotation(0.0f), scale(1.0f, 1.0f),
+		parent(), world_matrix(1.0f), cached_rotation(0.0f), world_version(0), parent_version(0), is_transform_dirty(true),
+		previous_position(pos), previous_rotation(0.0f),
+		sprite(spr), owns_sprite(owns_sprite), velocity(vel),
+		boundary(boundary_policy::clamp), is_visible(true), is_active(true), is_killed(false), layer(0), depth(0.0f) {}
+
+	// Children are left without a parent, keeping their local transform
 	~GameObject() {
-		delete sprite;
+		set_parent(nullptr);
+		for (GameObject* child : children) {
+			child->parent = nullptr;
+			child->is_transform_dirty = true;
+		}
+
+		if (owns_sprite)
+			delete sprite;
 	}
 
 	glm::vec2 get_position() const { return position; }
-	void set_position(const glm::vec2& new_position) { position = new_position; }
+	void set_position(const glm::vec2& new_position) { Redraw::assign(position, new_position); }
 
 	glm::vec2 get_velocity() const { return velocity; }
-	void set_velocity(const glm::vec2& new_velocity) { velocity = new_velocity; }
+	void set_velocity(const glm::vec2& new_velocity) { Redraw::assign(velocity, new_velocity); }
 
 	glm::vec3 get_line() const { return primitive.line; }
-	void set_line(const glm::vec3& new_line) { primitive.line = new_line; }
+	void set_line(const glm::vec3& new_line) { Redraw::assign(primitive.line, new_line); }
 
 	glm::vec3 get_fill() const { return primitive.fill; }
-	void set_fill(const glm::vec3& new_fill) { primitive.fill = new_fill; }
+	void set_fill(const glm::vec3& new_fill) { Redraw::assign(primitive.fill, new_fill); }
 
 	float get_rotation() const { return rotation; }
-	void set_rotation(float new_rotation) { rotation = new_rotation; }
+	void set_rotation(float new_rotation) { Redraw::assign(rotation, new_rotation); }
 
 	glm::vec2 get_scale() const { return scale; }
-	void set_scale(const glm::vec2& new_scale) { scale = new_scale; }
+	void set_scale(const glm::vec2& new_scale) { Redraw::assign(scale, new_scale); }
 
 	Sprite* get_sprite() const { return sprite; }
-	void set_sprite(Sprite* spr) { sprite = spr; }
+	void set_sprite(Sprite* spr) { Redraw::assign(sprite, spr); }
+
+	// Off for sprites that belong to a Pool or are shared between objects
+	GLboolean get_owns_sprite() const { return owns_sprite; }
+	void set_owns_sprite(const GLboolean owns_sprite) { this->owns_sprite = owns_sprite; }
 
 	primitive_type get_primitive_type() const { return primitive.type; }
 
+	// Scale that turns the unit shape in PrimitiveCache into this primitive
+	glm::vec2 get_primitive_dimensions() const {
+		switch (primitive.type) {
+		case primitive_type::circle:
+			return glm::vec2(primitive.radius);
+		case primitive_type::cube:
+			return glm::vec2(primitive.size);
+		case primitive_type::triangle:
+			return glm::vec2(primitive.base, primitive.height);
+		default:
+			return glm::vec2(0.0f);
+		}
+	}
+
+	boundary_policy get_boundary() const { return boundary; }
+	void set_boundary(const boundary_policy boundary) { this->boundary = boundary; }
+
+	// Set once a kill boundary has taken the object out; it stops updating
+	// and drawing, and its owner should delete or despawn it
+	GLboolean get_is_killed() const { return is_killed; }
+
 	GLboolean get_is_visible() const { return is_visible; }
-	void set_is_visible(const GLboolean is_visible) { this->is_visible = is_visible; }
+	void set_is_visible(const GLboolean is_visible) { Redraw::assign(this->is_visible, is_visible); }
 
 	GLboolean get_is_active() const { return is_active; }
-	void set_is_active(const GLboolean is_active) { this->is_active = is_active; }
+	void set_is_active(const GLboolean is_active) { Redraw::assign(this->is_active, is_active); }
+
+	unsigned int get_layer() const { return layer; }
+	// 0 to RenderQueue::max_layer; larger values are clamped
+	void set_layer(const unsigned int layer) { Redraw::assign(this->layer, std::min(layer, RenderQueue::max_layer)); }
+
+	GLfloat get_depth() const { return depth; }
+	void set_depth(const GLfloat depth) { Redraw::assign(this->depth, depth); }
+
+	GameObject* get_parent() const { return parent; }
+	const std::vector<GameObject*>& get_children() const { return children; }
+
+	// Parents only affect the transform; children are still updated and
+	// rendered from whatever list they are in. Returns false, changing
+	// nothing, if new_parent is this object or one of its descendants.
+	bool set_parent(GameObject* new_parent) {
+		if (new_parent == parent)
+			return true;
+		for (GameObject* ancestor = new_parent; ancestor; ancestor = ancestor->parent) {
+			if (ancestor == this)
+				return false;
+		}
+
+		if (parent) {
+			std::vector<GameObject*>& siblings = parent->children;
+			siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+		}
+
+		parent = new_parent;
+		if (parent)
+			parent->children.push_back(this);
+
+		is_transform_dirty = true;
+		Redraw::mark_dirty();
+		return true;
+	}
+
+	// Brings world_matrix up to date, ancestors first. Not thread-safe,
+	// since ancestors are shared; RenderRecorder runs it before recording.
+	void update_transform() {
+		if (parent)
+			parent->update_transform();
+
+		glm::vec2 render_position = get_render_position();
+		float render_rotation = get_render_rotation();
+		bool has_parent_changed = parent && parent->world_version != parent_version;
+
+		if (!is_transform_dirty && !has_parent_changed && render_position == cached_position &&
+			render_rotation == cached_rotation && scale == cached_scale)
+			return;
+
+		cached_position = render_position;
+		cached_rotation = render_rotation;
+		cached_scale = scale;
+
+		glm::mat3 local = Transform2D::make(render_position, render_rotation, scale);
+		world_matrix = parent ? parent->world_matrix * local : local;
+		parent_version = parent ? parent->world_version : 0;
+		world_version++;
+		is_transform_dirty = false;
+	}
 
+	// As of the last update_transform()
+	const glm::mat3& get_world_matrix() const { return world_matrix; }
+	glm::vec2 get_world_position() const { return glm::vec2(world_matrix[2]); }
+
+	// Call before anything moves the object in a simulation step, so
+	// rendering can blend from here to wherever the step leaves it
+	void store_previous_state() {
+		previous_position = position;
+		previous_rotation = rotation;
+	}
+
+	// Moves without blending, e.g. after a teleport
+	void reset_previous_state() { store_previous_state(); }
+
+	// Movement since store_previous_state(), in the parent's space
+	glm::vec2 get_displacement() const { return position - previous_position; }
+
+	static float get_interpolation() { return interpolation; }
+	// 0 draws every object where its step began, 1 where it is now
+	static void set_interpolation(float alpha) { interpolation = glm::clamp(alpha, 0.0f, 1.0f); }
+
+	// Transform as drawn this frame
+	glm::vec2 get_render_position() const {
+		if (interpolation >= 1.0f)
+			return position;
+		return glm::mix(previous_position, position, interpolation);
+	}
+
+	float get_render_rotation() const {
+		if (interpolation >= 1.0f)
+			return rotation;
+		// Shortest way round, so 350 -> 10 does not spin backwards
+		float delta = fmod(rotation - previous_rotation + 540.0f, 360.0f) - 180.0f;
+		return previous_rotation + delta * interpolation;
+	}
+
+	// Touches nothing but this object and its sprite, so it can run off
+	// the GLUT thread
 	void update(float dt) {
 		if (is_active) {
 			if (sprite) {
 				sprite->update(dt);
 			}
+			glm::vec2 old_position = position;
 			position += velocity * dt;
-			check_edges();
+			// A child's position is relative to its parent, not the world
+			if (!parent)
+				check_edges();
+			if (position != old_position)
+				Redraw::mark_dirty();
 		}
 	}
 
 	void render() {
-		glPushMatrix();
+		update_transform();
+		if (!is_visible || !is_in_view())
+			return;
 
-		glTranslatef(position.x, position.y, 0.0f);
-		glRotatef(rotation, 0.0f, 0.0f, 1.0f);
-		glScalef(scale.x, scale.y, 1.0f);
+		if (sprite) {
+			glm::vec2 corners[4];
+			get_sprite_corners(corners);
 
-		if (is_visible) {
-			if (sprite) {
-				glEnable(GL_TEXTURE_2D);
-				sprite->render();
-				glDisable(GL_TEXTURE_2D);
-			}
+			GLState::enable(GL_TEXTURE_2D);
+			sprite->render(corners);
+			GLState::disable(GL_TEXTURE_2D);
+		}
 
-		switch (primitive.type) {
-			case primitive_type::circle:
-				draw_circle(primitive.radius);
-				break;
-			case primitive_type::cube:
-				draw_cube(primitive.size);
-				break;
-			case primitive_type::triangle:
-				draw_triangle(primitive.base, primitive.height);
-				break;
-			default:
-				break;
-			}
+		draw_primitive();
+	}
+
+	// Sprites go into the batch; primitives still draw immediately, so the
+	// batch is flushed first to keep them on top of the sprite.
+	void render(SpriteBatch& batch) {
+		update_transform();
+		if (!is_visible || !is_in_view())
+			return;
+
+		if (sprite) {
+			glm::vec2 corners[4];
+			get_sprite_corners(corners);
+
+			glm::vec2 tex_coords[4];
+			sprite->get_tex_coords(tex_coords);
+
+			batch.draw(sprite->get_texture(), sprite->get_is_transparent(), corners, tex_coords, sprite->get_tint());
 		}
 
-		glPopMatrix();
+		if (primitive.type != primitive_type::none) {
+			batch.flush();
+			draw_primitive();
+		}
 	}
 
-private:
-	void draw_circle(float radius) {
-		glDisable(GL_TEXTURE_2D);
+	// Sprites go into the batch and primitives into the instancer, so all
+	// primitives end up on top of all sprites once both are flushed.
+	void render(SpriteBatch& batch, PrimitiveInstancer& instancer) {
+		update_transform();
+		if (!is_visible || !is_in_view())
+			return;
+
+		if (sprite) {
+			glm::vec2 corners[4];
+			get_sprite_corners(corners);
+
+			glm::vec2 tex_coords[4];
+			sprite->get_tex_coords(tex_coords);
 
-		glLineWidth(2.0f);
-		glColor3f(primitive.line.r, primitive.line.g, primitive.line.b);
-		glBegin(GL_LINE_LOOP);
-		const int segments = 50;
-		for (int i = 0; i < segments; i++) {
-			float theta = glm::radians((i / static_cast<float>(segments)) * 360.0f);
-			glVertex2f(cos(theta) * radius, sin(theta) * radius);
+			batch.draw(sprite->get_texture(), sprite->get_is_transparent(), corners, tex_coords, sprite->get_tint());
 		}
-		glEnd();
 
-		glColor3f(primitive.fill.r, primitive.fill.g, primitive.fill.b);
-		glBegin(GL_POLYGON);
-		for (int i = 0; i < segments; i++) {
-			float theta = glm::radians((i / static_cast<float>(segments)) * 360.0f);
-			glVertex2f(cos(theta) * radius, sin(theta) * radius);
+		if (primitive.type != primitive_type::none) {
+			instancer.draw(primitive.type, primitive.segments, get_primitive_matrix(), primitive.line, primitive.fill);
 		}
-		glEnd();
+	}
+
+	void render(RenderQueue& queue) {
+		update_transform();
+		if (!is_visible || !is_in_view())
+			return;
 
-		glEnable(GL_TEXTURE_2D);
+		submit(queue);
 	}
 
-	void draw_cube(float size) {
-		glDisable(GL_TEXTURE_2D);
+	// render(RenderQueue&) without the visibility and culling checks, for
+	// callers that already did them and ran update_transform(). Touches no
+	// GL or shared state.
+	void submit(RenderQueue& queue) const {
+		if (sprite) {
+			glm::vec2 corners[4];
+			get_sprite_corners(corners);
 
-		glLineWidth(2.0f);
-		glColor3f(primitive.line.r, primitive.line.g, primitive.line.b);
-		glBegin(GL_LINE_LOOP);
-		glVertex2f(-size / 2, -size / 2);
-		glVertex2f(size / 2, -size / 2);
-		glVertex2f(size / 2, size / 2);
-		glVertex2f(-size / 2, size / 2);
-		glEnd();
+			glm::vec2 tex_coords[4];
+			sprite->get_tex_coords(tex_coords);
 
-		glColor3f(primitive.fill.r, primitive.fill.g, primitive.fill.b);
-		glBegin(GL_POLYGON);
-		glVertex2f(-size / 2, -size / 2);
-		glVertex2f(size / 2, -size / 2);
-		glVertex2f(size / 2, size / 2);
-		glVertex2f(-size / 2, size / 2);
-		glEnd();
+			queue.submit_sprite(layer, depth, sprite->get_texture(), sprite->get_is_transparent(),
+				corners, tex_coords, sprite->get_tint());
+		}
 
-		glEnable(GL_TEXTURE_2D);
+		if (primitive.type != primitive_type::none) {
+			queue.submit_primitive(layer, depth, primitive.type, primitive.segments, get_primitive_matrix(),
+				primitive.line, primitive.fill);
+		}
 	}
 
-	void draw_triangle(float base, float height) {
-		glDisable(GL_TEXTURE_2D);
-
-		glLineWidth(2.0f);
-		glColor3f(primitive.line.r, primitive.line.g, primitive.line.b);
-		glBegin(GL_LINE_LOOP);
-		glVertex2f(-base / 2, -height / 2);
-		glVertex2f(base / 2, -height / 2);
-		glVertex2f(0.0f, height / 2);
-		glEnd();
+	// World-space box around the sprite quad and the primitive as drawn,
+	// parents, rotation and scale included. Uses the cached world matrix.
+	void get_bounds(glm::vec2& min, glm::vec2& max) const {
+		get_bounds(world_matrix, min, max);
+	}
 
-		glColor3f(primitive.fill.r, primitive.fill.g, primitive.fill.b);
-		glBegin(GL_POLYGON);
-		glVertex2f(-base / 2, -height / 2);
-		glVertex2f(base / 2, -height / 2);
-		glVertex2f(0.0f, height / 2);
-		glEnd();
+	// Same box for the current simulation state rather than what was last
+	// drawn, for collision tests during update
+	void get_collision_bounds(glm::vec2& min, glm::vec2& max) const {
+		get_bounds(get_simulation_matrix(), min, max);
+	}
 
-		glEnable(GL_TEXTURE_2D);
+	// World transform from the current position, rotation and scale, not
+	// interpolated and not cached. Walks up the parents.
+	glm::mat3 get_simulation_matrix() const {
+		glm::mat3 local = Transform2D::make(position, rotation, scale);
+		return parent ? parent->get_simulation_matrix() * local : local;
 	}
 
-	void check_edges() {
-		if (position.x > glutGet(GLUT_WINDOW_WIDTH)) {
-			position.x = static_cast<float>(glutGet(GLUT_WINDOW_WIDTH));
+	// Whether the opaque texels of the two sprites touch, in the current
+	// simulation state with the current frame and flip. A sprite without a
+	// collision mask counts as solid; objects without a sprite never touch.
+	// Unrotated sprites drawn at one texel per world unit are ANDed a row
+	// at a time; anything else is sampled at this sprite's texel centers.
+	bool overlaps_pixels(const GameObject& other) const {
+		if (!sprite || !other.sprite)
+			return false;
+
+		const CollisionMask* mask = sprite->get_collision_mask();
+		const CollisionMask* other_mask = other.sprite->get_collision_mask();
+		glm::mat3 texels = get_texel_matrix();
+		glm::mat3 other_texels = other.get_texel_matrix();
+
+		if (mask && other_mask && is_texel_aligned(texels) && is_texel_aligned(other_texels)) {
+			glm::ivec2 offset(glm::round(glm::vec2(other_texels[2]) - glm::vec2(texels[2])));
+			return CollisionMask::overlaps(*mask, sprite->get_current_frame(), get_texel_flip(),
+				*other_mask, other.sprite->get_current_frame(), other.get_texel_flip(), offset);
+		}
+
+		glm::ivec2 size = get_texel_size();
+		glm::ivec2 other_size = other.get_texel_size();
+		if (size.x <= 0 || size.y <= 0 || other_size.x <= 0 || other_size.y <= 0)
+			return false;
+
+		// Only texels inside the other sprite's box are worth sampling
+		glm::vec2 other_min, other_max, first, last;
+		Transform2D::bounds(other_texels, glm::vec2(0.0f), glm::vec2(other_size), other_min, other_max);
+		Transform2D::bounds(glm::inverse(texels), other_min, other_max, first, last);
+
+		glm::ivec2 from = glm::max(glm::ivec2(glm::floor(first)), glm::ivec2(0));
+		glm::ivec2 to = glm::min(glm::ivec2(glm::ceil(last)), size);
+		glm::mat3 to_other = glm::inverse(other_texels) * texels;
+
+		for (int y = from.y; y < to.y; y++) {
+			for (int x = from.x; x < to.x; x++) {
+				if (!is_texel_set(x, y))
+					continue;
+
+				glm::vec2 p = glm::floor(Transform2D::apply(to_other, glm::vec2(x + 0.5f, y + 0.5f)));
+				if (other.is_texel_set(static_cast<int>(p.x), static_cast<int>(p.y)))
+					return true;
+			}
 		}
-		else if (position.x < 0) {
-			position.x = 0.0f;
+
+		return false;
+	}
+
+private:
+	void get_bounds(const glm::mat3& world, glm::vec2& min, glm::vec2& max) const {
+		min = glm::vec2(world[2]);
+		max = min;
+
+		if (sprite) {
+			glm::vec2 size = sprite->get_size();
+			glm::vec2 sprite_min, sprite_max;
+			Transform2D::bounds(world, glm::vec2(0.0f), size, sprite_min, sprite_max);
+			min = glm::min(min, sprite_min);
+			max = glm::max(max, sprite_max);
 		}
-		if (position.y > glutGet(GLUT_WINDOW_HEIGHT)) {
-			position.y = static_cast<float>(glutGet(GLUT_WINDOW_HEIGHT));
+
+		if (primitive.type != primitive_type::none) {
+			// Every unit shape fits in a box of half extent 1 (circle) or 0.5
+			glm::vec2 half_extent(primitive.type == primitive_type::circle ? 1.0f : 0.5f);
+
+			glm::vec2 shape_min, shape_max;
+			Transform2D::bounds(glm::scale(world, get_primitive_dimensions()), -half_extent, half_extent, shape_min, shape_max);
+			min = glm::min(min, shape_min);
+			max = glm::max(max, shape_max);
 		}
-		else if (position.y < 0) {
-			position.y = 0.0f;
+	}
+
+	bool is_in_view() const {
+		if (!ViewCulling::get_is_enabled())
+			return true;
+
+		glm::vec2 min, max;
+		get_bounds(min, max);
+		return ViewCulling::test(min, max);
+	}
+
+	// The sprite's texel grid (mask frame size, or one texel per unit of
+	// sprite size without a mask) to the world
+	glm::mat3 get_texel_matrix() const {
+		glm::vec2 texel_size = glm::vec2(get_texel_size());
+		glm::vec2 size = sprite->get_size();
+		return glm::scale(get_simulation_matrix(),
+			glm::vec2(texel_size.x > 0.0f ? size.x / texel_size.x : 0.0f, texel_size.y > 0.0f ? size.y / texel_size.y : 0.0f));
+	}
+
+	glm::ivec2 get_texel_size() const {
+		const CollisionMask* mask = sprite->get_collision_mask();
+		if (mask)
+			return glm::ivec2(mask->get_frame_width(), mask->get_frame_height());
+		return glm::ivec2(glm::ceil(sprite->get_size()));
+	}
+
+	glm::bvec2 get_texel_flip() const {
+		glm::vec2 flip = sprite->get_sprite_flip();
+		return glm::bvec2(flip.x != 0.0f, flip.y != 0.0f);
+	}
+
+	bool is_texel_set(int x, int y) const {
+		const CollisionMask* mask = sprite->get_collision_mask();
+		if (mask)
+			return mask->get_pixel(sprite->get_current_frame(), get_texel_flip(), x, y);
+
+		glm::ivec2 size = get_texel_size();
+		return x >= 0 && y >= 0 && x < size.x && y < size.y;
+	}
+
+	static bool is_texel_aligned(const glm::mat3& m) {
+		const float epsilon = 1e-4f;
+		return fabs(m[0][0] - 1.0f) < epsilon && fabs(m[0][1]) < epsilon &&
+			fabs(m[1][0]) < epsilon && fabs(m[1][1] - 1.0f) < epsilon;
+	}
+
+	// Unit shape in PrimitiveCache to the world
+	glm::mat3 get_primitive_matrix() const {
+		return glm::scale(world_matrix, get_primitive_dimensions());
+	}
+
+	// Sprite quad through the cached world matrix
+	void get_sprite_corners(glm::vec2 corners[4]) const {
+		glm::vec2 size = sprite->get_size();
+
+		const glm::vec2 local[4] = {
+			glm::vec2(0.0f, 0.0f),
+			glm::vec2(size.x, 0.0f),
+			glm::vec2(size.x, size.y),
+			glm::vec2(0.0f, size.y)
+		};
+
+		for (int i = 0; i < 4; i++)
+			corners[i] = Transform2D::apply(world_matrix, local[i]);
+	}
+
+	void draw_primitive() {
+		if (primitive.type == primitive_type::none)
+			return;
+
+		GLState::disable(GL_TEXTURE_2D);
+		PrimitiveCache::draw(primitive.type, primitive.segments, get_primitive_matrix(), primitive.line, primitive.fill);
+		GLState::enable(GL_TEXTURE_2D);
+	}
+
+	void check_edges() {
+		if (!Boundary::resolve(position, velocity, boundary, Boundary::get_world_min(), Boundary::get_world_max(),
+			&previous_position)) {
+			is_killed = true;
+			is_active = false;
+			is_visible = false;
 		}
 	}
 };
+
+float GameObject::interpolation = 1.0f;
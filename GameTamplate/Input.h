@@ -4,6 +4,10 @@
 #include <glm.hpp>
 #include <iostream>
 
+#include "Redraw.h"
+#include "ViewCulling.h"
+#include "AabbTree.h"
+
 class Input {
 public:
     static bool is_cursor_locked;
@@ -17,6 +21,10 @@ private:
     static glm::vec3 last_position;
     static glm::vec3 delta_position;
 
+    static AabbTree* pick_tree;
+    static GameObject* picked_object;
+    static glm::vec2 click_position;
+
 public:
     static void mouse_move(int x, int y);
     static void set_callback_functions();
@@ -30,6 +38,14 @@ public:
     static void update();
     static void update_cursor_lock();
     static glm::vec3& get_mouse();
+
+    // Left clicks pick the topmost object in this tree under the cursor
+    static void set_pick_tree(AabbTree* tree);
+    // nullptr if the last click hit nothing
+    static GameObject* get_picked_object();
+    static void clear_picked_object();
+    // World position of the last left click
+    static glm::vec2 get_click_position();
 };
 
 bool Input::key_states[256] = { false };
@@ -40,10 +56,15 @@ glm::vec3 Input::mouse_position = glm::vec3(0.0f, 0.0f, 0.0f);
 glm::vec3 Input::last_position = glm::vec3(0.0f, 0.0f, 0.0f);
 glm::vec3 Input::delta_position = glm::vec3(0.0f, 0.0f, 0.0f);
 
+AabbTree* Input::pick_tree = nullptr;
+GameObject* Input::picked_object = nullptr;
+glm::vec2 Input::click_position = glm::vec2(0.0f, 0.0f);
+
 void Input::mouse_move(int x, int y)
 {
     mouse_position.x = x;
     mouse_position.y = y;
+    Redraw::mark_dirty();
 }
 
 void Input::set_callback_functions() {
@@ -77,6 +98,7 @@ void Input::keyboard(unsigned char key, int x, int y) {
         key = toupper(key);
 
     key_states[key] = true;
+    Redraw::mark_dirty();
 }
 
 void Input::keyboard_up(unsigned char key, int x, int y) {
@@ -85,12 +107,19 @@ void Input::keyboard_up(unsigned char key, int x, int y) {
 
     key_states[key] = false;
     key_down_dected[key] = false;
+    Redraw::mark_dirty();
 }
 
 void Input::mouse_click(int button, int state, int x, int y) {
     if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
-        std::cout << "Cursor Position: x = " << x << ", y = " << y << std::endl;
+        // Center of the clicked pixel. Window y grows downwards, the
+        // world's upwards; the view is the one reshape() last set.
+        glm::vec2 view_min = ViewCulling::get_view_min();
+        glm::vec2 view_max = ViewCulling::get_view_max();
+        click_position = glm::vec2(view_min.x + x + 0.5f, view_max.y - y - 0.5f);
+        picked_object = pick_tree ? pick_tree->pick(click_position) : nullptr;
     }
+    Redraw::mark_dirty();
 }
 
 bool Input::is_any_key_pressed() {
@@ -132,3 +161,14 @@ void Input::update_cursor_lock() {
 }
 
 glm::vec3& Input::get_mouse() { return delta_position; }
+
+void Input::set_pick_tree(AabbTree* tree) {
+    pick_tree = tree;
+    picked_object = nullptr;
+}
+
+GameObject* Input::get_picked_object() { return picked_object; }
+
+void Input::clear_picked_object() { picked_object = nullptr; }
+
+glm::vec2 Input::get_click_position() { return click_position; }
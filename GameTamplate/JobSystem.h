@@ -0,0 +1,260 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Completion counter for a group of jobs. Every job submitted with it as
+// its signal adds one; the count drops back as they finish. A job can also
+// wait for a counter to reach zero before it is allowed to start.
+struct job_counter {
+	std::atomic<int> remaining;
+
+	job_counter() : remaining(0) {}
+	bool is_done() const { return remaining.load(std::memory_order_acquire) == 0; }
+};
+
+// Work-stealing job scheduler. Every thread has its own deque: it pushes
+// and pops jobs at the back, and idle threads steal from the front of the
+// others, so work spreads out without one shared queue everyone fights
+// over. The thread that calls wait() runs jobs too instead of blocking.
+//
+// In serial mode jobs run right away on the submitting thread, in the
+// same order a single core would run them, which is what you want under
+// a debugger.
+class JobSystem {
+private:
+	struct job {
+		std::function<void()> function;
+		job_counter* signal;
+		job_counter* dependency;
+	};
+
+	struct job_queue {
+		std::mutex mutex;
+		std::deque<job> jobs;
+	};
+
+	unsigned int thread_count;
+	bool is_serial;
+
+	// Index 0 is shared by every thread that is not a worker
+	std::vector<std::unique_ptr<job_queue>> queues;
+	std::vector<std::thread> workers;
+
+	// Jobs whose dependency has not finished yet
+	std::mutex waiting_mutex;
+	std::vector<job> waiting;
+
+	std::mutex sleep_mutex;
+	std::condition_variable work_available;
+	std::atomic<int> queued_jobs;
+	std::atomic<bool> is_stopping;
+
+	std::atomic<unsigned int> jobs_stolen;
+
+public:
+	// thread_count 0 uses every hardware thread
+	JobSystem(unsigned int thread_count = 0)
+		: thread_count(thread_count), is_serial(false), queued_jobs(0), is_stopping(false), jobs_stolen(0) {
+
+		if (this->thread_count == 0)
+			this->thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+		for (unsigned int i = 0; i < this->thread_count; i++)
+			queues.push_back(std::unique_ptr<job_queue>(new job_queue()));
+	}
+
+	~JobSystem() {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			is_stopping = true;
+		}
+		work_available.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Queues a job. signal, if given, counts it until it has run; the job
+	// does not start before dependency, if given, has reached zero, so
+	// submit the jobs it depends on first.
+	void submit(std::function<void()> function, job_counter* signal = nullptr, job_counter* dependency = nullptr) {
+		if (signal)
+			signal->remaining.fetch_add(1, std::memory_order_relaxed);
+
+		job j = { std::move(function), signal, dependency };
+
+		if (dependency && !dependency->is_done()) {
+			std::lock_guard<std::mutex> lock(waiting_mutex);
+			// Checked again under the lock, the dependency may have just finished
+			if (!dependency->is_done()) {
+				waiting.push_back(std::move(j));
+				return;
+			}
+		}
+
+		enqueue(std::move(j));
+	}
+
+	// Runs other jobs until the counter reaches zero
+	void wait(const job_counter& counter) {
+		while (!counter.is_done()) {
+			job j;
+			if (try_take(current_index(), j))
+				run(j);
+			else
+				std::this_thread::yield();
+		}
+	}
+
+	// f(first, last) over [first, last) in chunks of at most grain items
+	template <typename F>
+	void parallel_for(std::size_t first, std::size_t last, std::size_t grain, F f) {
+		if (first >= last)
+			return;
+		grain = std::max<std::size_t>(1, grain);
+
+		if (is_serial || thread_count == 1 || last - first <= grain) {
+			f(first, last);
+			return;
+		}
+
+		job_counter done;
+		for (std::size_t begin = first; begin < last; begin += grain) {
+			std::size_t end = std::min(last, begin + grain);
+			submit([&f, begin, end]() { f(begin, end); }, &done);
+		}
+		wait(done);
+	}
+
+	unsigned int get_thread_count() const { return thread_count; }
+
+	bool get_is_serial() const { return is_serial; }
+	// Only switch while no jobs are in flight
+	void set_is_serial(const bool is_serial) { this->is_serial = is_serial; }
+
+	unsigned int get_jobs_stolen() const { return jobs_stolen.load(std::memory_order_relaxed); }
+
+private:
+	// Worker threads remember their index; everyone else uses queue 0
+	static unsigned int& current_index() {
+		static thread_local unsigned int index = 0;
+		return index;
+	}
+
+	void enqueue(job j) {
+		if (is_serial || thread_count == 1) {
+			run(j);
+			return;
+		}
+
+		if (workers.empty())
+			start_workers();
+
+		job_queue& queue = *queues[current_index()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(std::move(j));
+		}
+		queued_jobs.fetch_add(1, std::memory_order_release);
+
+		// Taking the lock orders this with a worker that is about to sleep
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+		}
+		work_available.notify_one();
+	}
+
+	void start_workers() {
+		for (unsigned int i = 1; i < thread_count; i++)
+			workers.push_back(std::thread(&JobSystem::worker_loop, this, i));
+	}
+
+	void worker_loop(unsigned int index) {
+		current_index() = index;
+
+		for (;;) {
+			job j;
+			if (try_take(index, j)) {
+				run(j);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			work_available.wait(lock, [this] {
+				return is_stopping.load() || queued_jobs.load(std::memory_order_acquire) > 0;
+			});
+			if (is_stopping)
+				return;
+		}
+	}
+
+	// Own queue from the back (most recent, still in cache), then steal
+	// from the front of the others
+	bool try_take(unsigned int index, job& j) {
+		if (queued_jobs.load(std::memory_order_acquire) == 0)
+			return false;
+
+		{
+			job_queue& own = *queues[index];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.jobs.empty()) {
+				j = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				queued_jobs.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		for (unsigned int offset = 1; offset < thread_count; offset++) {
+			job_queue& victim = *queues[(index + offset) % thread_count];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.jobs.empty()) {
+				j = std::move(victim.jobs.front());
+				victim.jobs.pop_front();
+				queued_jobs.fetch_sub(1, std::memory_order_relaxed);
+				jobs_stolen.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void run(job& j) {
+		j.function();
+
+		if (j.signal && j.signal->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			release_waiting(j.signal);
+	}
+
+	// Queues every waiting job whose dependency just reached zero
+	void release_waiting(const job_counter* finished) {
+		std::vector<job> ready;
+		{
+			std::lock_guard<std::mutex> lock(waiting_mutex);
+			for (std::size_t i = 0; i < waiting.size();) {
+				if (waiting[i].dependency == finished) {
+					ready.push_back(std::move(waiting[i]));
+					waiting[i] = std::move(waiting.back());
+					waiting.pop_back();
+				}
+				else {
+					i++;
+				}
+			}
+		}
+
+		for (job& j : ready)
+			enqueue(std::move(j));
+	}
+};
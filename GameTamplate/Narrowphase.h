@@ -0,0 +1,537 @@
+#pragma once
+#include "SpatialHash.h"
+#include "Simd.h"
+
+#include <cfloat>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// A GameObject's primitive in world space, from its simulation transform.
+// Cubes and triangles become convex polygons, so rotation and non-uniform
+// scale are exact for them. A circle stays a circle with the larger of its
+// two scaled radii; non-uniformly scaled circles are not ellipses here.
+struct collision_shape {
+	// none for objects without a primitive, or scaled down to nothing
+	primitive_type type;
+
+	glm::vec2 center;
+	float radius;
+
+	// Counter-clockwise. Edge i runs from vertices[i] to the next vertex
+	// and normals[i] is its outward unit normal. Triangles repeat their
+	// last edge as a fourth, so every polygon has four edges.
+	glm::vec2 vertices[4];
+	glm::vec2 normals[4];
+	int count;
+};
+
+// Contact between the two objects of a broadphase pair. normal is a unit
+// vector from a towards b; moving b by normal * depth separates them.
+struct contact {
+	GameObject* a;
+	GameObject* b;
+	glm::vec2 normal;
+	float depth;
+};
+
+// Exact tests for the pairs the broadphase found. Pairs are sorted into
+// circle-circle, polygon-circle and polygon-polygon batches laid out one
+// column per value, and each batch runs through one kernel 8 (AVX2) or 4
+// (SSE2, NEON) pairs at a time. The kernels are written once against the
+// lane types below; the scalar one is also what collide() uses for a
+// single pair.
+class Narrowphase {
+public:
+	typedef SpatialHash::object_pair object_pair;
+
+private:
+	// Every column is padded to a multiple of this, so any lane width fits
+	static const std::size_t max_width = 8;
+
+	// Per polygon edge: start x, start y, end x, end y, normal x, normal y
+	static const int edge_columns = 6;
+	static const int polygon_columns = 4 * edge_columns;
+
+	enum batch_kind {
+		circle_circle,
+		polygon_circle,
+		polygon_polygon,
+		batch_kind_count
+	};
+
+	// Results: normal x, normal y, depth
+	static const int result_columns = 3;
+
+	struct entry {
+		GameObject* a;
+		GameObject* b;
+		// The circle was a; the kernel always gets the polygon first
+		bool is_swapped;
+	};
+
+	struct batch {
+		std::vector<entry> entries;
+		// Column c of pair i at c * stride + i
+		std::vector<float> columns;
+		std::vector<float> results;
+		std::size_t stride;
+	};
+
+	batch batches[batch_kind_count];
+	// Two per entry, a then b, until they are packed into columns
+	std::vector<collision_shape> batch_shapes[batch_kind_count];
+
+	unsigned int pairs_tested;
+
+public:
+	Narrowphase() : pairs_tested(0) {}
+
+	Narrowphase(const Narrowphase&) = delete;
+	Narrowphase& operator=(const Narrowphase&) = delete;
+
+	// Appends a contact for every pair whose shapes overlap. Objects without
+	// a primitive are skipped. Not thread-safe; it reuses its own buffers.
+	void collide(const std::vector<object_pair>& pairs, std::vector<contact>& contacts) {
+		for (int kind = 0; kind < batch_kind_count; kind++) {
+			batches[kind].entries.clear();
+			batch_shapes[kind].clear();
+		}
+		pairs_tested = 0;
+
+		for (const object_pair& pair : pairs) {
+			collision_shape a, b;
+			if (!make_shape(*pair.first, a) || !make_shape(*pair.second, b))
+				continue;
+
+			entry e = { pair.first, pair.second, false };
+			if (a.type == primitive_type::circle && b.type != primitive_type::circle) {
+				std::swap(a, b);
+				e.is_swapped = true;
+			}
+
+			batch_kind kind = a.type == primitive_type::circle ? circle_circle
+				: b.type == primitive_type::circle ? polygon_circle : polygon_polygon;
+			batches[kind].entries.push_back(e);
+			batch_shapes[kind].push_back(a);
+			batch_shapes[kind].push_back(b);
+		}
+
+		for (int kind = 0; kind < batch_kind_count; kind++) {
+			batch& b = batches[kind];
+			if (b.entries.empty())
+				continue;
+
+			pack(static_cast<batch_kind>(kind), batch_shapes[kind], b);
+			run<native_lanes>(static_cast<batch_kind>(kind), b.columns.data(), b.results.data(), b.stride);
+			pairs_tested += static_cast<unsigned int>(b.entries.size());
+
+			const float* normal_x = &b.results[0];
+			const float* normal_y = &b.results[b.stride];
+			const float* depth = &b.results[2 * b.stride];
+			for (std::size_t i = 0; i < b.entries.size(); i++) {
+				if (!(depth[i] > 0.0f))
+					continue;
+
+				const entry& e = b.entries[i];
+				glm::vec2 normal(normal_x[i], normal_y[i]);
+				contact c = { e.a, e.b, e.is_swapped ? -normal : normal, depth[i] };
+				contacts.push_back(c);
+			}
+		}
+	}
+
+	// Appends the pairs whose sprites touch texel for texel, see
+	// GameObject::overlaps_pixels. Only pairs where at least one sprite has
+	// a collision mask are tested; for the rest the boxes are all there is.
+	void collide_sprites(const std::vector<object_pair>& pairs, std::vector<object_pair>& hits) const {
+		for (const object_pair& pair : pairs) {
+			Sprite* a = pair.first->get_sprite();
+			Sprite* b = pair.second->get_sprite();
+			if (!a || !b || (!a->get_collision_mask() && !b->get_collision_mask()))
+				continue;
+
+			if (pair.first->overlaps_pixels(*pair.second))
+				hits.push_back(pair);
+		}
+	}
+
+	// One pair without batching. Returns whether they overlap; normal
+	// points from a to b.
+	static bool collide(const collision_shape& a, const collision_shape& b, glm::vec2& normal, float& depth) {
+		if (a.type == primitive_type::none || b.type == primitive_type::none)
+			return false;
+
+		bool is_swapped = a.type == primitive_type::circle && b.type != primitive_type::circle;
+		const collision_shape& first = is_swapped ? b : a;
+		const collision_shape& second = is_swapped ? a : b;
+
+		batch_kind kind = first.type == primitive_type::circle ? circle_circle
+			: second.type == primitive_type::circle ? polygon_circle : polygon_polygon;
+
+		float columns[2 * polygon_columns];
+		float results[result_columns];
+		write_shapes(kind, first, second, columns, 0, 1);
+		run<lanes_scalar>(kind, columns, results, 1);
+
+		normal = glm::vec2(results[0], results[1]);
+		if (is_swapped)
+			normal = -normal;
+		depth = results[2];
+		return depth > 0.0f;
+	}
+
+	// World-space shape of the object's primitive. Returns false if there is
+	// nothing to test.
+	static bool make_shape(const GameObject& object, collision_shape& shape) {
+		shape.type = object.get_primitive_type();
+		shape.count = 0;
+		if (shape.type == primitive_type::none)
+			return false;
+
+		glm::mat3 m = glm::scale(object.get_simulation_matrix(), object.get_primitive_dimensions());
+		shape.center = glm::vec2(m[2]);
+
+		if (shape.type == primitive_type::circle) {
+			shape.radius = glm::max(glm::length(glm::vec2(m[0])), glm::length(glm::vec2(m[1])));
+			if (!(shape.radius > 0.0f)) {
+				shape.type = primitive_type::none;
+				return false;
+			}
+			return true;
+		}
+
+		// The unit shapes PrimitiveCache draws
+		static const glm::vec2 cube[4] = {
+			glm::vec2(-0.5f, -0.5f), glm::vec2(0.5f, -0.5f), glm::vec2(0.5f, 0.5f), glm::vec2(-0.5f, 0.5f)
+		};
+		static const glm::vec2 triangle[3] = {
+			glm::vec2(-0.5f, -0.5f), glm::vec2(0.5f, -0.5f), glm::vec2(0.0f, 0.5f)
+		};
+
+		const glm::vec2* local = shape.type == primitive_type::cube ? cube : triangle;
+		int count = shape.type == primitive_type::cube ? 4 : 3;
+
+		// A mirroring scale turns the winding clockwise
+		float determinant = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+		if (!(std::fabs(determinant) > 0.0f)) {
+			shape.type = primitive_type::none;
+			return false;
+		}
+		for (int i = 0; i < count; i++)
+			shape.vertices[i] = Transform2D::apply(m, local[determinant > 0.0f ? i : count - 1 - i]);
+
+		for (int i = 0; i < count; i++) {
+			glm::vec2 edge = shape.vertices[(i + 1) % count] - shape.vertices[i];
+			shape.normals[i] = glm::normalize(glm::vec2(edge.y, -edge.x));
+		}
+
+		if (count == 3) {
+			shape.vertices[3] = shape.vertices[2];
+			shape.normals[3] = shape.normals[2];
+		}
+		shape.count = count;
+		return true;
+	}
+
+	// Pairs that reached a kernel during the last collide()
+	unsigned int get_pairs_tested() const { return pairs_tested; }
+
+private:
+	static int get_column_count(batch_kind kind) {
+		switch (kind) {
+		case circle_circle:
+			return 6;
+		case polygon_circle:
+			return polygon_columns + 3;
+		default:
+			return 2 * polygon_columns;
+		}
+	}
+
+	void pack(batch_kind kind, const std::vector<collision_shape>& kind_shapes, batch& b) {
+		std::size_t count = b.entries.size();
+		b.stride = (count + max_width - 1) / max_width * max_width;
+
+		// Padding lanes are all zero, which every kernel reports as no contact
+		b.columns.assign(get_column_count(kind) * b.stride, 0.0f);
+		b.results.resize(result_columns * b.stride);
+
+		for (std::size_t i = 0; i < count; i++)
+			write_shapes(kind, kind_shapes[2 * i], kind_shapes[2 * i + 1], b.columns.data(), i, b.stride);
+	}
+
+	static void write_shapes(batch_kind kind, const collision_shape& a, const collision_shape& b,
+		float* columns, std::size_t i, std::size_t stride) {
+
+		if (kind == circle_circle) {
+			write_circle(a, columns, i, stride);
+			write_circle(b, columns + 3 * stride, i, stride);
+			return;
+		}
+
+		write_polygon(a, columns, i, stride);
+		if (kind == polygon_circle)
+			write_circle(b, columns + polygon_columns * stride, i, stride);
+		else
+			write_polygon(b, columns + polygon_columns * stride, i, stride);
+	}
+
+	static void write_circle(const collision_shape& shape, float* columns, std::size_t i, std::size_t stride) {
+		columns[i] = shape.center.x;
+		columns[stride + i] = shape.center.y;
+		columns[2 * stride + i] = shape.radius;
+	}
+
+	static void write_polygon(const collision_shape& shape, float* columns, std::size_t i, std::size_t stride) {
+		for (int e = 0; e < 4; e++) {
+			// The repeated fourth edge of a triangle ends where the third does
+			const glm::vec2& start = shape.vertices[e];
+			const glm::vec2& end = shape.vertices[(e == 3 && shape.count == 3) ? 0 : (e + 1) % shape.count];
+
+			float* edge = columns + e * edge_columns * stride;
+			edge[i] = start.x;
+			edge[stride + i] = start.y;
+			edge[2 * stride + i] = end.x;
+			edge[3 * stride + i] = end.y;
+			edge[4 * stride + i] = shape.normals[e].x;
+			edge[5 * stride + i] = shape.normals[e].y;
+		}
+	}
+
+	template <typename L>
+	static void run(batch_kind kind, const float* columns, float* results, std::size_t stride) {
+		switch (kind) {
+		case circle_circle:
+			collide_circles<L>(columns, results, stride);
+			break;
+		case polygon_circle:
+			collide_polygon_circle<L>(columns, results, stride);
+			break;
+		default:
+			collide_polygons<L>(columns, results, stride);
+			break;
+		}
+	}
+
+	template <typename L>
+	static void collide_circles(const float* columns, float* results, std::size_t stride) {
+		typedef typename L::value value;
+		const value zero = L::set(0.0f);
+		const value one = L::set(1.0f);
+		const value tiny = L::set(FLT_MIN);
+
+		for (std::size_t i = 0; i < stride; i += L::width) {
+			value dx = L::sub(L::load(columns + 3 * stride + i), L::load(columns + i));
+			value dy = L::sub(L::load(columns + 4 * stride + i), L::load(columns + stride + i));
+			value radii = L::add(L::load(columns + 2 * stride + i), L::load(columns + 5 * stride + i));
+
+			value distance = L::sqrt(L::add(L::mul(dx, dx), L::mul(dy, dy)));
+			value safe = L::max(distance, tiny);
+
+			// Concentric circles get pushed apart along +y
+			value is_apart = L::less(zero, distance);
+			L::store(results + i, L::select(is_apart, L::div(dx, safe), zero));
+			L::store(results + stride + i, L::select(is_apart, L::div(dy, safe), one));
+			L::store(results + 2 * stride + i, L::sub(radii, distance));
+		}
+	}
+
+	// Inside the polygon, the edge the center is least deep behind gives the
+	// way out. Outside, the closest point over all edges does; the farthest
+	// edge alone is not always the closest one near a corner.
+	template <typename L>
+	static void collide_polygon_circle(const float* columns, float* results, std::size_t stride) {
+		typedef typename L::value value;
+		const value zero = L::set(0.0f);
+		const value one = L::set(1.0f);
+		const value tiny = L::set(FLT_MIN);
+		const float* circle = columns + polygon_columns * stride;
+
+		for (std::size_t i = 0; i < stride; i += L::width) {
+			value cx = L::load(circle + i);
+			value cy = L::load(circle + stride + i);
+			value radius = L::load(circle + 2 * stride + i);
+
+			value separation = L::set(-FLT_MAX);
+			value normal_x = zero, normal_y = zero;
+			value closest = L::set(FLT_MAX);
+			value offset_x = zero, offset_y = zero;
+
+			for (int e = 0; e < 4; e++) {
+				const float* edge = columns + e * edge_columns * stride + i;
+				value sx = L::load(edge);
+				value sy = L::load(edge + stride);
+				value nx = L::load(edge + 4 * stride);
+				value ny = L::load(edge + 5 * stride);
+
+				value px = L::sub(cx, sx);
+				value py = L::sub(cy, sy);
+				value s = L::add(L::mul(nx, px), L::mul(ny, py));
+				value is_farther = L::less(separation, s);
+				separation = L::select(is_farther, s, separation);
+				normal_x = L::select(is_farther, nx, normal_x);
+				normal_y = L::select(is_farther, ny, normal_y);
+
+				value ex = L::sub(L::load(edge + 2 * stride), sx);
+				value ey = L::sub(L::load(edge + 3 * stride), sy);
+				value t = L::div(L::add(L::mul(px, ex), L::mul(py, ey)), L::max(L::add(L::mul(ex, ex), L::mul(ey, ey)), tiny));
+				t = L::min(L::max(t, zero), one);
+
+				value dx = L::sub(px, L::mul(t, ex));
+				value dy = L::sub(py, L::mul(t, ey));
+				value distance_squared = L::add(L::mul(dx, dx), L::mul(dy, dy));
+				value is_closer = L::less(distance_squared, closest);
+				closest = L::select(is_closer, distance_squared, closest);
+				offset_x = L::select(is_closer, dx, offset_x);
+				offset_y = L::select(is_closer, dy, offset_y);
+			}
+
+			value distance = L::sqrt(closest);
+			value safe = L::max(distance, tiny);
+
+			value is_outside = L::less(zero, separation);
+			L::store(results + i, L::select(is_outside, L::div(offset_x, safe), normal_x));
+			L::store(results + stride + i, L::select(is_outside, L::div(offset_y, safe), normal_y));
+			L::store(results + 2 * stride + i, L::sub(radius, L::select(is_outside, distance, separation)));
+		}
+	}
+
+	// Separating axis test over the edge normals of both polygons. The axis
+	// with the least overlap gives the normal and the depth.
+	template <typename L>
+	static void collide_polygons(const float* columns, float* results, std::size_t stride) {
+		typedef typename L::value value;
+		const value zero = L::set(0.0f);
+
+		for (std::size_t i = 0; i < stride; i += L::width) {
+			value separation = L::set(-FLT_MAX);
+			value normal_x = zero, normal_y = zero;
+
+			for (int side = 0; side < 2; side++) {
+				const float* own = columns + (side ? polygon_columns * stride : 0) + i;
+				const float* other = columns + (side ? 0 : polygon_columns * stride) + i;
+
+				value vx[4], vy[4];
+				for (int v = 0; v < 4; v++) {
+					vx[v] = L::load(other + v * edge_columns * stride);
+					vy[v] = L::load(other + (v * edge_columns + 1) * stride);
+				}
+
+				for (int e = 0; e < 4; e++) {
+					const float* edge = own + e * edge_columns * stride;
+					value sx = L::load(edge);
+					value sy = L::load(edge + stride);
+					value nx = L::load(edge + 4 * stride);
+					value ny = L::load(edge + 5 * stride);
+
+					// How far the other polygon's deepest vertex is in front of this edge
+					value s = L::set(FLT_MAX);
+					for (int v = 0; v < 4; v++)
+						s = L::min(s, L::add(L::mul(nx, L::sub(vx[v], sx)), L::mul(ny, L::sub(vy[v], sy))));
+
+					// b's normals point away from b, towards a
+					if (side) {
+						nx = L::sub(zero, nx);
+						ny = L::sub(zero, ny);
+					}
+
+					value is_farther = L::less(separation, s);
+					separation = L::select(is_farther, s, separation);
+					normal_x = L::select(is_farther, nx, normal_x);
+					normal_y = L::select(is_farther, ny, normal_y);
+				}
+			}
+
+			L::store(results + i, normal_x);
+			L::store(results + stride + i, normal_y);
+			L::store(results + 2 * stride + i, L::sub(zero, separation));
+		}
+	}
+
+	struct lanes_scalar {
+		static const std::size_t width = 1;
+		typedef float value;
+
+		static value set(float f) { return f; }
+		static value load(const float* p) { return *p; }
+		static void store(float* p, value v) { *p = v; }
+		static value add(value a, value b) { return a + b; }
+		static value sub(value a, value b) { return a - b; }
+		static value mul(value a, value b) { return a * b; }
+		static value div(value a, value b) { return a / b; }
+		static value min(value a, value b) { return a < b ? a : b; }
+		static value max(value a, value b) { return a > b ? a : b; }
+		static value sqrt(value a) { return std::sqrt(a); }
+		// Masks are 1 or 0
+		static value less(value a, value b) { return a < b ? 1.0f : 0.0f; }
+		static value select(value mask, value a, value b) { return mask != 0.0f ? a : b; }
+	};
+
+#if defined(SIMD_AVX2)
+	struct lanes_avx {
+		static const std::size_t width = 8;
+		typedef __m256 value;
+
+		static value set(float f) { return _mm256_set1_ps(f); }
+		static value load(const float* p) { return _mm256_loadu_ps(p); }
+		static void store(float* p, value v) { _mm256_storeu_ps(p, v); }
+		static value add(value a, value b) { return _mm256_add_ps(a, b); }
+		static value sub(value a, value b) { return _mm256_sub_ps(a, b); }
+		static value mul(value a, value b) { return _mm256_mul_ps(a, b); }
+		static value div(value a, value b) { return _mm256_div_ps(a, b); }
+		static value min(value a, value b) { return _mm256_min_ps(a, b); }
+		static value max(value a, value b) { return _mm256_max_ps(a, b); }
+		static value sqrt(value a) { return _mm256_sqrt_ps(a); }
+		static value less(value a, value b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static value select(value mask, value a, value b) { return _mm256_blendv_ps(b, a, mask); }
+	};
+	typedef lanes_avx native_lanes;
+#elif defined(SIMD_SSE2)
+	struct lanes_sse {
+		static const std::size_t width = 4;
+		typedef __m128 value;
+
+		static value set(float f) { return _mm_set1_ps(f); }
+		static value load(const float* p) { return _mm_loadu_ps(p); }
+		static void store(float* p, value v) { _mm_storeu_ps(p, v); }
+		static value add(value a, value b) { return _mm_add_ps(a, b); }
+		static value sub(value a, value b) { return _mm_sub_ps(a, b); }
+		static value mul(value a, value b) { return _mm_mul_ps(a, b); }
+		static value div(value a, value b) { return _mm_div_ps(a, b); }
+		static value min(value a, value b) { return _mm_min_ps(a, b); }
+		static value max(value a, value b) { return _mm_max_ps(a, b); }
+		static value sqrt(value a) { return _mm_sqrt_ps(a); }
+		static value less(value a, value b) { return _mm_cmplt_ps(a, b); }
+		static value select(value mask, value a, value b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	};
+	typedef lanes_sse native_lanes;
+#elif defined(SIMD_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+	// vsqrtq_f32 and vdivq_f32 are AArch64 only
+	struct lanes_neon {
+		static const std::size_t width = 4;
+		typedef float32x4_t value;
+
+		static value set(float f) { return vdupq_n_f32(f); }
+		static value load(const float* p) { return vld1q_f32(p); }
+		static void store(float* p, value v) { vst1q_f32(p, v); }
+		static value add(value a, value b) { return vaddq_f32(a, b); }
+		static value sub(value a, value b) { return vsubq_f32(a, b); }
+		static value mul(value a, value b) { return vmulq_f32(a, b); }
+		static value div(value a, value b) { return vdivq_f32(a, b); }
+		static value min(value a, value b) { return vminq_f32(a, b); }
+		static value max(value a, value b) { return vmaxq_f32(a, b); }
+		static value sqrt(value a) { return vsqrtq_f32(a); }
+		static value less(value a, value b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+		static value select(value mask, value a, value b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+	};
+	typedef lanes_neon native_lanes;
+#else
+	typedef lanes_scalar native_lanes;
+#endif
+};
+
+const std::size_t Narrowphase::max_width;
+const int Narrowphase::edge_columns;
+const int Narrowphase::polygon_columns;
+const int Narrowphase::result_columns;
@@ -0,0 +1,102 @@
+#pragma once
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "SOIL2.h"
+
+#include <iostream>
+#include <vector>
+
+// Color buffer for rendering without a visible window. Frames go into an
+// RGBA8 texture behind a framebuffer object; everything that would bind
+// framebuffer 0 binds GLState::get_window_framebuffer() instead, so the
+// regular render() ends up here unchanged.
+//
+// Without framebuffer objects the back buffer of the (hidden) window is
+// used, which limits the size to what the window system gives it.
+class OffscreenTarget {
+private:
+	GLuint texture;
+	GLuint framebuffer;
+	int width;
+	int height;
+
+	GLboolean use_framebuffer;
+
+public:
+	OffscreenTarget() : texture(0), framebuffer(0), width(0), height(0), use_framebuffer(false) {}
+
+	~OffscreenTarget() {
+		release();
+	}
+
+	OffscreenTarget(const OffscreenTarget&) = delete;
+	OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+	// Needs a current context; binds the target on success
+	bool create(int new_width, int new_height) {
+		release();
+
+		width = new_width;
+		height = new_height;
+
+		GLExtensions::load();
+		use_framebuffer = GLExtensions::has_framebuffers();
+
+		if (use_framebuffer) {
+			glGenTextures(1, &texture);
+			GLState::bind_texture(texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+			GLExtensions::gen_framebuffers(1, &framebuffer);
+			GLExtensions::bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+			GLExtensions::framebuffer_texture_2d(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+			if (GLExtensions::check_framebuffer_status(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				std::cout << "Offscreen framebuffer incomplete, rendering into the window instead" << std::endl;
+				release();
+				use_framebuffer = false;
+			}
+		}
+
+		if (!use_framebuffer) {
+			width = glm::min(width, glutGet(GLUT_WINDOW_WIDTH));
+			height = glm::min(height, glutGet(GLUT_WINDOW_HEIGHT));
+			glReadBuffer(GL_BACK);
+		}
+
+		GLState::set_window_framebuffer(framebuffer);
+		return width > 0 && height > 0;
+	}
+
+	void release() {
+		if (framebuffer) {
+			GLExtensions::bind_framebuffer(GL_FRAMEBUFFER, 0);
+			GLExtensions::delete_framebuffers(1, &framebuffer);
+			framebuffer = 0;
+		}
+		if (texture) {
+			glDeleteTextures(1, &texture);
+			texture = 0;
+		}
+		GLState::set_window_framebuffer(0);
+	}
+
+	// Tightly packed RGBA rows, bottom row first like glReadPixels
+	void read_pixels(std::vector<unsigned char>& pixels) const {
+		pixels.resize(static_cast<std::size_t>(width) * height * 4);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	}
+
+	// image_type is one of SOIL_SAVE_TYPE_*
+	bool save(const char* file_name, int image_type = SOIL_SAVE_TYPE_BMP) const {
+		return SOIL_save_screenshot(file_name, image_type, 0, 0, width, height) != 0;
+	}
+
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+	GLuint get_texture() const { return texture; }
+	GLboolean get_use_framebuffer() const { return use_framebuffer; }
+};
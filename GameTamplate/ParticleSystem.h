@@ -0,0 +1,273 @@
+#pragma once
+#include "Sprite.h"
+#include "SpriteBatch.h"
+#include "StreamBuffer.h"
+#include "Simd.h"
+
+#include <cstdint>
+#include <vector>
+
+// Fixed-capacity particle pool stored as structure-of-arrays. update()
+// integrates all particles with SSE/AVX and swaps dead ones out of the
+// live range, render() streams every live particle into one buffer.
+//
+// The sprite sheet is shared, not owned; particles pick a frame from it.
+// Without a sprite particles are drawn as untextured colored squares.
+class ParticleSystem {
+private:
+	std::size_t capacity;
+	std::size_t count;
+
+	std::vector<float> position_x;
+	std::vector<float> position_y;
+	std::vector<float> velocity_x;
+	std::vector<float> velocity_y;
+	std::vector<float> life;
+	std::vector<float> inverse_lifetime;
+	std::vector<float> size;
+	std::vector<glm::vec4> color;
+	std::vector<std::uint16_t> frame;
+
+	glm::vec2 gravity;
+	GLboolean fade_out;
+
+	Sprite* sprite;
+
+	std::vector<sprite_vertex> vertices;
+	StreamBuffer stream;
+
+	unsigned int particles_killed;
+
+public:
+	ParticleSystem(std::size_t capacity, Sprite* sheet = nullptr)
+		: capacity(capacity), count(0), gravity(0.0f), fade_out(true), sprite(sheet),
+		particles_killed(0) {
+
+		position_x.resize(capacity);
+		position_y.resize(capacity);
+		velocity_x.resize(capacity);
+		velocity_y.resize(capacity);
+		life.resize(capacity);
+		inverse_lifetime.resize(capacity);
+		size.resize(capacity);
+		color.resize(capacity);
+		frame.resize(capacity);
+		vertices.reserve(capacity * 4);
+	}
+
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	// Returns false when the pool is full
+	bool emit(const glm::vec2& pos, const glm::vec2& vel, const glm::vec4& col,
+		float lifetime, float particle_size, std::uint16_t sprite_frame = 0) {
+
+		if (count >= capacity || lifetime <= 0.0f)
+			return false;
+
+		std::size_t i = count++;
+		position_x[i] = pos.x;
+		position_y[i] = pos.y;
+		velocity_x[i] = vel.x;
+		velocity_y[i] = vel.y;
+		life[i] = lifetime;
+		inverse_lifetime[i] = 1.0f / lifetime;
+		size[i] = particle_size;
+		color[i] = col;
+		frame[i] = sprite_frame;
+		return true;
+	}
+
+	void update(float dt) {
+		integrate(dt);
+		compact();
+	}
+
+	void render() {
+		if (count == 0)
+			return;
+
+		build_vertices();
+
+		stream.begin_frame();
+		const GLubyte* base = stream.write(vertices.data(), vertices.size() * sizeof(sprite_vertex));
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glVertexPointer(2, GL_FLOAT, sizeof(sprite_vertex), base + offsetof(sprite_vertex, x));
+		glColorPointer(4, GL_FLOAT, sizeof(sprite_vertex), base + offsetof(sprite_vertex, r));
+
+		if (sprite) {
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			glTexCoordPointer(2, GL_FLOAT, sizeof(sprite_vertex), base + offsetof(sprite_vertex, u));
+			GLState::enable(GL_TEXTURE_2D);
+			GLState::bind_texture(sprite->get_texture());
+		}
+		else {
+			GLState::disable(GL_TEXTURE_2D);
+		}
+
+		GLState::enable(GL_BLEND);
+		GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		glDrawArrays(GL_QUADS, 0, static_cast<GLsizei>(vertices.size()));
+
+		GLState::disable(GL_BLEND);
+		GLState::disable(GL_TEXTURE_2D);
+		GLState::invalidate_color();
+
+		if (sprite)
+			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+
+		stream.unbind();
+	}
+
+	void clear() { count = 0; }
+
+	std::size_t get_count() const { return count; }
+	std::size_t get_capacity() const { return capacity; }
+	// Particles that expired during the last update()
+	unsigned int get_particles_killed() const { return particles_killed; }
+
+	glm::vec2 get_gravity() const { return gravity; }
+	void set_gravity(const glm::vec2& gravity) { this->gravity = gravity; }
+
+	GLboolean get_fade_out() const { return fade_out; }
+	void set_fade_out(const GLboolean fade_out) { this->fade_out = fade_out; }
+
+	Sprite* get_sprite() const { return sprite; }
+	void set_sprite(Sprite* sheet) { sprite = sheet; }
+
+	const StreamBuffer& get_stream() const { return stream; }
+
+private:
+	void integrate(float dt) {
+		std::size_t i = 0;
+
+		float* px = position_x.data();
+		float* py = position_y.data();
+		float* vx = velocity_x.data();
+		float* vy = velocity_y.data();
+		float* l = life.data();
+
+#if defined(SIMD_AVX2)
+		const __m256 dt8 = _mm256_set1_ps(dt);
+		const __m256 gx8 = _mm256_set1_ps(gravity.x * dt);
+		const __m256 gy8 = _mm256_set1_ps(gravity.y * dt);
+
+		for (; i + 8 <= count; i += 8) {
+			__m256 vel_x = _mm256_add_ps(_mm256_loadu_ps(vx + i), gx8);
+			__m256 vel_y = _mm256_add_ps(_mm256_loadu_ps(vy + i), gy8);
+			_mm256_storeu_ps(vx + i, vel_x);
+			_mm256_storeu_ps(vy + i, vel_y);
+			_mm256_storeu_ps(px + i, _mm256_add_ps(_mm256_loadu_ps(px + i), _mm256_mul_ps(vel_x, dt8)));
+			_mm256_storeu_ps(py + i, _mm256_add_ps(_mm256_loadu_ps(py + i), _mm256_mul_ps(vel_y, dt8)));
+			_mm256_storeu_ps(l + i, _mm256_sub_ps(_mm256_loadu_ps(l + i), dt8));
+		}
+#endif
+#if defined(SIMD_SSE2)
+		const __m128 dt4 = _mm_set1_ps(dt);
+		const __m128 gx4 = _mm_set1_ps(gravity.x * dt);
+		const __m128 gy4 = _mm_set1_ps(gravity.y * dt);
+
+		for (; i + 4 <= count; i += 4) {
+			__m128 vel_x = _mm_add_ps(_mm_loadu_ps(vx + i), gx4);
+			__m128 vel_y = _mm_add_ps(_mm_loadu_ps(vy + i), gy4);
+			_mm_storeu_ps(vx + i, vel_x);
+			_mm_storeu_ps(vy + i, vel_y);
+			_mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(vel_x, dt4)));
+			_mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(vel_y, dt4)));
+			_mm_storeu_ps(l + i, _mm_sub_ps(_mm_loadu_ps(l + i), dt4));
+		}
+#endif
+		float gx = gravity.x * dt;
+		float gy = gravity.y * dt;
+		for (; i < count; i++) {
+			vx[i] += gx;
+			vy[i] += gy;
+			px[i] += vx[i] * dt;
+			py[i] += vy[i] * dt;
+			l[i] -= dt;
+		}
+	}
+
+	// Dead particles are replaced by the last live one, so the live range
+	// stays dense and nothing is reallocated.
+	void compact() {
+		particles_killed = 0;
+
+		std::size_t i = 0;
+		while (i < count) {
+#if defined(SIMD_SSE2)
+			// Skip blocks of four live particles with a single compare
+			if (i + 4 <= count) {
+				__m128 dead = _mm_cmple_ps(_mm_loadu_ps(life.data() + i), _mm_setzero_ps());
+				if (_mm_movemask_ps(dead) == 0) {
+					i += 4;
+					continue;
+				}
+			}
+#endif
+			if (life[i] > 0.0f) {
+				i++;
+				continue;
+			}
+
+			count--;
+			particles_killed++;
+			move_particle(count, i);
+		}
+	}
+
+	void move_particle(std::size_t from, std::size_t to) {
+		if (from == to)
+			return;
+
+		position_x[to] = position_x[from];
+		position_y[to] = position_y[from];
+		velocity_x[to] = velocity_x[from];
+		velocity_y[to] = velocity_y[from];
+		life[to] = life[from];
+		inverse_lifetime[to] = inverse_lifetime[from];
+		size[to] = size[from];
+		color[to] = color[from];
+		frame[to] = frame[from];
+	}
+
+	void build_vertices() {
+		vertices.resize(count * 4);
+
+		glm::vec2 tex_coords[4] = { glm::vec2(0.0f), glm::vec2(0.0f), glm::vec2(0.0f), glm::vec2(0.0f) };
+		std::uint16_t cached_frame = 0xFFFF;
+		const glm::vec2 no_flip(0.0f);
+
+		for (std::size_t i = 0; i < count; i++) {
+			if (sprite && frame[i] != cached_frame) {
+				sprite->get_frame_tex_coords(frame[i], no_flip, tex_coords);
+				cached_frame = frame[i];
+			}
+
+			float half = size[i] * 0.5f;
+			glm::vec4 c = color[i];
+			if (fade_out)
+				c.a *= life[i] * inverse_lifetime[i];
+
+			const float corner_x[4] = { position_x[i] - half, position_x[i] + half, position_x[i] + half, position_x[i] - half };
+			const float corner_y[4] = { position_y[i] - half, position_y[i] - half, position_y[i] + half, position_y[i] + half };
+
+			sprite_vertex* quad = &vertices[i * 4];
+			for (int k = 0; k < 4; k++) {
+				quad[k].x = corner_x[k];
+				quad[k].y = corner_y[k];
+				quad[k].u = tex_coords[k].x;
+				quad[k].v = tex_coords[k].y;
+				quad[k].r = c.r;
+				quad[k].g = c.g;
+				quad[k].b = c.b;
+				quad[k].a = c.a;
+			}
+		}
+	}
+};
@@ -0,0 +1,203 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fixed-block object pool. Objects live in blocks of block_size slots that
+// are never moved or freed while the pool exists, so spawn and despawn are
+// O(1) and never touch the heap once the pool has warmed up.
+//
+// Objects are referred to by 32-bit handles: 20 bits of slot index and 12
+// bits of generation. A slot's generation changes every time it is freed,
+// so get() on a handle to a despawned object returns nullptr instead of a
+// dangling pointer.
+//
+// despawn() only queues the object; it stays valid until flush_despawns()
+// runs at the end of the frame, so nothing disappears mid-update or
+// between recording and drawing.
+template <typename T>
+class Pool {
+public:
+	struct handle {
+		std::uint32_t value;
+
+		handle() : value(0) {}
+		explicit handle(std::uint32_t value) : value(value) {}
+
+		bool is_null() const { return value == 0; }
+		bool operator==(const handle& other) const { return value == other.value; }
+		bool operator!=(const handle& other) const { return value != other.value; }
+	};
+
+	static const std::uint32_t index_bits = 20;
+	static const std::uint32_t max_slots = 1u << index_bits;
+	static const std::uint32_t generation_mask = 0xFFF;
+
+private:
+	static const std::uint32_t no_slot = 0xFFFFFFFF;
+
+	struct slot {
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+		std::uint32_t next_free;
+		std::uint16_t generation;
+		bool is_live;
+	};
+
+	std::size_t block_size;
+	std::vector<std::unique_ptr<slot[]>> blocks;
+
+	std::uint32_t first_free;
+	std::size_t slot_count;
+	std::size_t live_count;
+
+	std::vector<handle> pending_despawns;
+
+public:
+	Pool(std::size_t block_size = 256, std::size_t initial_capacity = 0)
+		: block_size(block_size ? block_size : 1), first_free(no_slot), slot_count(0), live_count(0) {
+
+		while (slot_count < initial_capacity && add_block()) {}
+	}
+
+	~Pool() {
+		for (std::size_t i = 0; i < slot_count; i++) {
+			slot& s = get_slot(static_cast<std::uint32_t>(i));
+			if (s.is_live)
+				object(s)->~T();
+		}
+	}
+
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+
+	// Constructs a T in a free slot. Returns a null handle when the pool is full.
+	template <typename... Args>
+	handle spawn(Args&&... args) {
+		if (first_free == no_slot && !add_block())
+			return handle();
+
+		std::uint32_t index = first_free;
+		slot& s = get_slot(index);
+		first_free = s.next_free;
+
+		new (&s.storage) T(std::forward<Args>(args)...);
+		s.is_live = true;
+		live_count++;
+
+		return handle((static_cast<std::uint32_t>(s.generation) << index_bits) | index);
+	}
+
+	// Queued until flush_despawns(). Despawning twice, or a stale handle, is harmless.
+	void despawn(handle h) {
+		if (get(h))
+			pending_despawns.push_back(h);
+	}
+
+	// Queues every live object for which pred(T&) is true
+	template <typename F>
+	void despawn_if(F pred) {
+		for (std::size_t i = 0; i < slot_count; i++) {
+			slot& s = get_slot(static_cast<std::uint32_t>(i));
+			if (s.is_live && pred(*object(s)))
+				pending_despawns.push_back(handle((static_cast<std::uint32_t>(s.generation) << index_bits) | static_cast<std::uint32_t>(i)));
+		}
+	}
+
+	// Destroys everything despawned since the last call; once per frame
+	void flush_despawns() {
+		for (handle h : pending_despawns) {
+			slot* s = find_slot(h);
+			if (!s)
+				continue;
+
+			object(*s)->~T();
+			s->is_live = false;
+
+			// Generation 0 is skipped so no live handle is ever 0
+			s->generation = static_cast<std::uint16_t>((s->generation + 1) & generation_mask);
+			if (s->generation == 0)
+				s->generation = 1;
+
+			std::uint32_t index = h.value & (max_slots - 1);
+			s->next_free = first_free;
+			first_free = index;
+			live_count--;
+		}
+		pending_despawns.clear();
+	}
+
+	// nullptr once the object has been despawned and flushed
+	T* get(handle h) {
+		slot* s = find_slot(h);
+		return s ? object(*s) : nullptr;
+	}
+
+	const T* get(handle h) const {
+		return const_cast<Pool*>(this)->get(h);
+	}
+
+	// Calls f(T&) for every live object, in slot order
+	template <typename F>
+	void for_each(F f) {
+		for (std::size_t i = 0; i < slot_count; i++) {
+			slot& s = get_slot(static_cast<std::uint32_t>(i));
+			if (s.is_live)
+				f(*object(s));
+		}
+	}
+
+	// Appends a pointer to every live object, e.g. for RenderRecorder
+	void collect(std::vector<T*>& objects) {
+		for_each([&objects](T& o) { objects.push_back(&o); });
+	}
+
+	std::size_t get_live_count() const { return live_count; }
+	// Slots already allocated but not in use
+	std::size_t get_free_count() const { return slot_count - live_count; }
+	std::size_t get_capacity() const { return slot_count; }
+	std::size_t get_pending_despawn_count() const { return pending_despawns.size(); }
+
+private:
+	static T* object(slot& s) { return reinterpret_cast<T*>(&s.storage); }
+
+	slot& get_slot(std::uint32_t index) {
+		return blocks[index / block_size][index % block_size];
+	}
+
+	slot* find_slot(handle h) {
+		std::uint32_t index = h.value & (max_slots - 1);
+		std::uint32_t generation = h.value >> index_bits;
+		if (h.is_null() || index >= slot_count)
+			return nullptr;
+
+		slot& s = get_slot(index);
+		return s.is_live && s.generation == generation ? &s : nullptr;
+	}
+
+	bool add_block() {
+		if (slot_count + block_size > max_slots)
+			return false;
+
+		blocks.push_back(std::unique_ptr<slot[]>(new slot[block_size]));
+		slot* block = blocks.back().get();
+
+		// Thread the new slots onto the free list in index order
+		for (std::size_t i = block_size; i-- > 0;) {
+			block[i].generation = 1;
+			block[i].is_live = false;
+			block[i].next_free = first_free;
+			first_free = static_cast<std::uint32_t>(slot_count + i);
+		}
+
+		slot_count += block_size;
+		return true;
+	}
+};
+
+template <typename T> const std::uint32_t Pool<T>::index_bits;
+template <typename T> const std::uint32_t Pool<T>::max_slots;
+template <typename T> const std::uint32_t Pool<T>::generation_mask;
+template <typename T> const std::uint32_t Pool<T>::no_slot;
@@ -0,0 +1,157 @@
+#pragma once
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "Primitives.h"
+#include "Transform2D.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+// Unit-sized outlines for each primitive shape, tessellated once and drawn
+// transformed. Circles have radius 1, cubes and triangles fit a 1x1 box
+// centred on the origin.
+class PrimitiveCache {
+private:
+	struct cached_shape {
+		std::vector<glm::vec2> vertices;
+		GLuint vertex_buffer;
+	};
+
+	typedef std::pair<primitive_type, int> shape_key;
+
+	static std::map<shape_key, cached_shape> shapes;
+	static bool use_vertex_buffers;
+	static bool is_initialized;
+
+	// Vertices of the shape being drawn, already transformed
+	static std::vector<glm::vec2> transformed;
+
+public:
+	static void draw(primitive_type type, int segments, const glm::vec2& scale,
+		const glm::vec3& line, const glm::vec3& fill);
+
+	// Unit shape through transform, on the CPU, so the matrix stack is
+	// left alone
+	static void draw(primitive_type type, int segments, const glm::mat3& transform,
+		const glm::vec3& line, const glm::vec3& fill);
+
+	static const std::vector<glm::vec2>& get_vertices(primitive_type type, int segments);
+	static GLuint get_vertex_buffer(primitive_type type, int segments);
+
+	static void clear();
+
+	static unsigned int get_shape_count() { return static_cast<unsigned int>(shapes.size()); }
+
+private:
+	static cached_shape& get_shape(primitive_type type, int segments);
+	static void build(primitive_type type, int segments, std::vector<glm::vec2>& vertices);
+};
+
+std::map<PrimitiveCache::shape_key, PrimitiveCache::cached_shape> PrimitiveCache::shapes;
+bool PrimitiveCache::use_vertex_buffers = false;
+bool PrimitiveCache::is_initialized = false;
+std::vector<glm::vec2> PrimitiveCache::transformed;
+
+void PrimitiveCache::draw(primitive_type type, int segments, const glm::vec2& scale,
+	const glm::vec3& line, const glm::vec3& fill) {
+
+	draw(type, segments, glm::scale(glm::mat3(1.0f), scale), line, fill);
+}
+
+void PrimitiveCache::draw(primitive_type type, int segments, const glm::mat3& transform,
+	const glm::vec3& line, const glm::vec3& fill) {
+
+	const std::vector<glm::vec2>& vertices = get_shape(type, segments).vertices;
+	if (vertices.empty())
+		return;
+
+	transformed.resize(vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); i++)
+		transformed[i] = Transform2D::apply(transform, vertices[i]);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, transformed.data());
+
+	GLsizei count = static_cast<GLsizei>(transformed.size());
+
+	GLState::set_line_width(2.0f);
+	GLState::set_color(line.r, line.g, line.b);
+	glDrawArrays(GL_LINE_LOOP, 0, count);
+
+	GLState::set_color(fill.r, fill.g, fill.b);
+	glDrawArrays(GL_POLYGON, 0, count);
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+const std::vector<glm::vec2>& PrimitiveCache::get_vertices(primitive_type type, int segments) {
+	return get_shape(type, segments).vertices;
+}
+
+GLuint PrimitiveCache::get_vertex_buffer(primitive_type type, int segments) {
+	return get_shape(type, segments).vertex_buffer;
+}
+
+void PrimitiveCache::clear() {
+	for (auto& entry : shapes) {
+		if (entry.second.vertex_buffer)
+			GLExtensions::delete_buffers(1, &entry.second.vertex_buffer);
+	}
+	shapes.clear();
+}
+
+PrimitiveCache::cached_shape& PrimitiveCache::get_shape(primitive_type type, int segments) {
+	if (!is_initialized) {
+		GLExtensions::load();
+		use_vertex_buffers = GLExtensions::has_vertex_buffers();
+		is_initialized = true;
+	}
+
+	// Only circles depend on the segment count
+	if (type != primitive_type::circle)
+		segments = 0;
+
+	shape_key key(type, segments);
+	auto found = shapes.find(key);
+	if (found != shapes.end())
+		return found->second;
+
+	cached_shape& shape = shapes[key];
+	shape.vertex_buffer = 0;
+	build(type, segments, shape.vertices);
+
+	if (use_vertex_buffers && !shape.vertices.empty()) {
+		GLExtensions::gen_buffers(1, &shape.vertex_buffer);
+		GLExtensions::bind_buffer(GL_ARRAY_BUFFER, shape.vertex_buffer);
+		GLExtensions::buffer_data(GL_ARRAY_BUFFER, shape.vertices.size() * sizeof(glm::vec2),
+			shape.vertices.data(), GL_STATIC_DRAW);
+		GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	return shape;
+}
+
+void PrimitiveCache::build(primitive_type type, int segments, std::vector<glm::vec2>& vertices) {
+	switch (type) {
+	case primitive_type::circle:
+		for (int i = 0; i < segments; i++) {
+			float theta = glm::radians((i / static_cast<float>(segments)) * 360.0f);
+			vertices.push_back(glm::vec2(cos(theta), sin(theta)));
+		}
+		break;
+	case primitive_type::cube:
+		vertices.push_back(glm::vec2(-0.5f, -0.5f));
+		vertices.push_back(glm::vec2(0.5f, -0.5f));
+		vertices.push_back(glm::vec2(0.5f, 0.5f));
+		vertices.push_back(glm::vec2(-0.5f, 0.5f));
+		break;
+	case primitive_type::triangle:
+		vertices.push_back(glm::vec2(-0.5f, -0.5f));
+		vertices.push_back(glm::vec2(0.5f, -0.5f));
+		vertices.push_back(glm::vec2(0.0f, 0.5f));
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,280 @@
+#pragma once
+#include "PrimitiveCache.h"
+#include "StreamBuffer.h"
+
+#include <iostream>
+
+// Columns of the instance's affine transform, see Transform2D
+struct primitive_instance {
+	glm::vec2 axis_x;
+	glm::vec2 axis_y;
+	glm::vec2 origin;
+	glm::vec3 line;
+	glm::vec3 fill;
+};
+
+// Draws every primitive of the same shape with one glDrawArraysInstanced
+// per pass (outline, then fill). Needs GL 3.3; otherwise each instance
+// is transformed on the CPU and drawn through PrimitiveCache like
+// GameObject::render does.
+class PrimitiveInstancer {
+private:
+	enum attribute_location {
+		vertex_location = 0,
+		axis_x_location,
+		axis_y_location,
+		origin_location,
+		line_location,
+		fill_location
+	};
+
+	typedef std::pair<primitive_type, int> shape_key;
+
+	std::map<shape_key, std::vector<primitive_instance>> instances;
+
+	GLuint program;
+	GLint use_fill_location;
+	StreamBuffer stream;
+	GLboolean use_instancing;
+	GLboolean is_initialized;
+
+	unsigned int instances_submitted;
+	unsigned int draw_calls;
+
+public:
+	PrimitiveInstancer()
+		: program(0), use_fill_location(-1),
+		use_instancing(false), is_initialized(false), instances_submitted(0), draw_calls(0) {}
+
+	~PrimitiveInstancer() {
+		if (program)
+			GLExtensions::delete_program(program);
+	}
+
+	PrimitiveInstancer(const PrimitiveInstancer&) = delete;
+	PrimitiveInstancer& operator=(const PrimitiveInstancer&) = delete;
+
+	void begin() {
+		if (!is_initialized)
+			initialize();
+		if (use_instancing)
+			stream.begin_frame();
+
+		for (auto& entry : instances)
+			entry.second.clear();
+		instances_submitted = 0;
+		draw_calls = 0;
+	}
+
+	// scale is the object scale already multiplied by the shape size
+	void draw(primitive_type type, int segments, const glm::vec2& position, GLfloat rotation,
+		const glm::vec2& scale, const glm::vec3& line, const glm::vec3& fill) {
+
+		draw(type, segments, Transform2D::make(position, rotation, scale), line, fill);
+	}
+
+	// transform maps the unit shape to the world, shape size included
+	void draw(primitive_type type, int segments, const glm::mat3& transform,
+		const glm::vec3& line, const glm::vec3& fill) {
+
+		if (type == primitive_type::none)
+			return;
+		if (type != primitive_type::circle)
+			segments = 0;
+
+		primitive_instance instance;
+		instance.axis_x = glm::vec2(transform[0]);
+		instance.axis_y = glm::vec2(transform[1]);
+		instance.origin = glm::vec2(transform[2]);
+		instance.line = line;
+		instance.fill = fill;
+		instances[shape_key(type, segments)].push_back(instance);
+
+		instances_submitted++;
+	}
+
+	void end() {
+		if (!is_initialized)
+			initialize();
+
+		GLState::disable(GL_TEXTURE_2D);
+		GLState::set_line_width(2.0f);
+
+		for (auto& entry : instances) {
+			if (entry.second.empty())
+				continue;
+
+			if (use_instancing)
+				draw_instanced(entry.first, entry.second);
+			else
+				draw_fallback(entry.first, entry.second);
+
+			entry.second.clear();
+		}
+
+		GLState::enable(GL_TEXTURE_2D);
+	}
+
+	unsigned int get_instances_submitted() const { return instances_submitted; }
+	unsigned int get_draw_calls() const { return draw_calls; }
+
+	const StreamBuffer& get_stream() const { return stream; }
+
+	GLboolean get_use_instancing() const { return use_instancing; }
+	void set_use_instancing(const GLboolean use_instancing) {
+		if (!is_initialized)
+			initialize();
+		this->use_instancing = use_instancing && program != 0;
+	}
+
+private:
+	void initialize() {
+		GLExtensions::load();
+
+		if (GLExtensions::has_instancing()) {
+			program = create_program();
+			if (program) {
+				use_fill_location = GLExtensions::get_uniform_location(program, "use_fill");
+			}
+		}
+
+		use_instancing = program != 0;
+		is_initialized = true;
+	}
+
+	void draw_instanced(const shape_key& key, const std::vector<primitive_instance>& shape_instances) {
+		const std::vector<glm::vec2>& vertices = PrimitiveCache::get_vertices(key.first, key.second);
+		if (vertices.empty())
+			return;
+
+		const GLubyte* base = stream.write(shape_instances.data(), shape_instances.size() * sizeof(primitive_instance));
+		GLsizei stride = sizeof(primitive_instance);
+		set_instance_attribute(axis_x_location, 2, stride, base + offsetof(primitive_instance, axis_x));
+		set_instance_attribute(axis_y_location, 2, stride, base + offsetof(primitive_instance, axis_y));
+		set_instance_attribute(origin_location, 2, stride, base + offsetof(primitive_instance, origin));
+		set_instance_attribute(line_location, 3, stride, base + offsetof(primitive_instance, line));
+		set_instance_attribute(fill_location, 3, stride, base + offsetof(primitive_instance, fill));
+
+		GLExtensions::bind_buffer(GL_ARRAY_BUFFER, PrimitiveCache::get_vertex_buffer(key.first, key.second));
+		GLExtensions::enable_vertex_attrib_array(vertex_location);
+		GLExtensions::vertex_attrib_pointer(vertex_location, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+		GLExtensions::use_program(program);
+
+		GLsizei count = static_cast<GLsizei>(vertices.size());
+		GLsizei instance_count = static_cast<GLsizei>(shape_instances.size());
+
+		GLExtensions::uniform_1i(use_fill_location, 0);
+		GLExtensions::draw_arrays_instanced(GL_LINE_LOOP, 0, count, instance_count);
+
+		GLExtensions::uniform_1i(use_fill_location, 1);
+		GLExtensions::draw_arrays_instanced(GL_TRIANGLE_FAN, 0, count, instance_count);
+
+		draw_calls += 2;
+
+		GLExtensions::use_program(0);
+
+		for (GLuint location = vertex_location; location <= fill_location; location++) {
+			GLExtensions::vertex_attrib_divisor(location, 0);
+			GLExtensions::disable_vertex_attrib_array(location);
+		}
+		GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void draw_fallback(const shape_key& key, const std::vector<primitive_instance>& shape_instances) {
+		for (const primitive_instance& instance : shape_instances) {
+			glm::mat3 transform(glm::vec3(instance.axis_x, 0.0f), glm::vec3(instance.axis_y, 0.0f), glm::vec3(instance.origin, 1.0f));
+			PrimitiveCache::draw(key.first, key.second, transform, instance.line, instance.fill);
+
+			draw_calls += 2;
+		}
+	}
+
+	void set_instance_attribute(GLuint location, GLint size, GLsizei stride, const GLubyte* offset) {
+		GLExtensions::enable_vertex_attrib_array(location);
+		GLExtensions::vertex_attrib_pointer(location, size, GL_FLOAT, GL_FALSE, stride, offset);
+		GLExtensions::vertex_attrib_divisor(location, 1);
+	}
+
+	GLuint compile_shader(GLenum type, const char* source) {
+		GLuint shader = GLExtensions::create_shader(type);
+		GLExtensions::shader_source(shader, 1, &source, nullptr);
+		GLExtensions::compile_shader(shader);
+
+		GLint status = 0;
+		GLExtensions::get_shader_iv(shader, GL_COMPILE_STATUS, &status);
+		if (!status) {
+			char log[512];
+			GLExtensions::get_shader_info_log(shader, sizeof(log), nullptr, log);
+			std::cout << "Instancing shader compilation failed: " << log << std::endl;
+			GLExtensions::delete_shader(shader);
+			return 0;
+		}
+
+		return shader;
+	}
+
+	GLuint create_program() {
+		// The fixed-function matrices set up in reshape() are still used for projection
+		const char* vertex_source =
+			"#version 120\n"
+			"attribute vec2 vertex;\n"
+			"attribute vec2 instance_axis_x;\n"
+			"attribute vec2 instance_axis_y;\n"
+			"attribute vec2 instance_origin;\n"
+			"attribute vec3 instance_line;\n"
+			"attribute vec3 instance_fill;\n"
+			"uniform bool use_fill;\n"
+			"varying vec3 color;\n"
+			"void main() {\n"
+			"	vec2 p = instance_origin + vertex.x * instance_axis_x + vertex.y * instance_axis_y;\n"
+			"	color = use_fill ? instance_fill : instance_line;\n"
+			"	gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 0.0, 1.0);\n"
+			"}\n";
+
+		const char* fragment_source =
+			"#version 120\n"
+			"varying vec3 color;\n"
+			"void main() {\n"
+			"	gl_FragColor = vec4(color, 1.0);\n"
+			"}\n";
+
+		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+		if (!vertex_shader || !fragment_shader) {
+			if (vertex_shader)
+				GLExtensions::delete_shader(vertex_shader);
+			if (fragment_shader)
+				GLExtensions::delete_shader(fragment_shader);
+			return 0;
+		}
+
+		GLuint new_program = GLExtensions::create_program();
+		GLExtensions::attach_shader(new_program, vertex_shader);
+		GLExtensions::attach_shader(new_program, fragment_shader);
+
+		GLExtensions::bind_attrib_location(new_program, vertex_location, "vertex");
+		GLExtensions::bind_attrib_location(new_program, axis_x_location, "instance_axis_x");
+		GLExtensions::bind_attrib_location(new_program, axis_y_location, "instance_axis_y");
+		GLExtensions::bind_attrib_location(new_program, origin_location, "instance_origin");
+		GLExtensions::bind_attrib_location(new_program, line_location, "instance_line");
+		GLExtensions::bind_attrib_location(new_program, fill_location, "instance_fill");
+
+		GLExtensions::link_program(new_program);
+
+		GLExtensions::delete_shader(vertex_shader);
+		GLExtensions::delete_shader(fragment_shader);
+
+		GLint status = 0;
+		GLExtensions::get_program_iv(new_program, GL_LINK_STATUS, &status);
+		if (!status) {
+			char log[512];
+			GLExtensions::get_program_info_log(new_program, sizeof(log), nullptr, log);
+			std::cout << "Instancing shader linking failed: " << log << std::endl;
+			GLExtensions::delete_program(new_program);
+			return 0;
+		}
+
+		return new_program;
+	}
+};
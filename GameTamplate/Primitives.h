@@ -6,7 +6,8 @@
 enum primitive_type {
 	circle,
 	cube,
-	triangle
+	triangle,
+	none
 };
 
 struct primitive {
@@ -14,17 +15,21 @@ struct primitive {
 	glm::vec3 line;
 	glm::vec3 fill;
 
-	primitive() = default;
+	primitive()
+		: type(primitive_type::none), line(0.0f), fill(0.0f),
+		radius(0.0f), segments(0), size(0.0f), base(0.0f), height(0.0f) {}
 
 	//krug
 	float radius;
+	int segments;
 
-	static primitive create_circle(const glm::vec3& line_color, const glm::vec3& fill_color, float r) {
+	static primitive create_circle(const glm::vec3& line_color, const glm::vec3& fill_color, float r, int n = 50) {
 		primitive p;
 		p.type = primitive_type::circle;
 		p.line = line_color;
 		p.fill = fill_color;
 		p.radius = r;
+		p.segments = n;
 		return p;
 	}
 
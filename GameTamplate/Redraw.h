@@ -0,0 +1,125 @@
+#pragma once
+#include <freeglut.h>
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+// Demand-driven redraw. Anything that changes what is on screen calls
+// mark_dirty(); anything that will change by itself later (an animation
+// frame) calls schedule_in(). With demand mode enabled the loop only posts
+// another redisplay when the frame it just drew left the scene dirty or a
+// scheduled time has come, so an unchanged scene costs no CPU at all.
+//
+// With demand mode off every call here is just bookkeeping. mark_dirty()
+// and schedule_in() may be called from update jobs on any thread.
+class Redraw {
+public:
+	typedef std::chrono::steady_clock clock;
+
+private:
+	static bool is_enabled;
+	static std::atomic<bool> is_dirty;
+	static bool is_in_frame;
+
+	// Clock ticks of the earliest scheduled wakeup, no_schedule if none
+	static const clock::rep no_schedule = std::numeric_limits<clock::rep>::max();
+	static std::atomic<clock::rep> scheduled_ticks;
+
+	static bool is_timer_armed;
+	static clock::time_point timer_time;
+
+	static unsigned int frames_drawn;
+
+public:
+	// Only after the window exists, since changes outside a frame post a redisplay
+	static void set_is_enabled(bool enabled) { is_enabled = enabled; }
+	static bool get_is_enabled() { return is_enabled; }
+
+	static void mark_dirty() {
+		// Read first so thousands of movers don't keep writing the same line
+		if (!is_dirty.load(std::memory_order_relaxed))
+			is_dirty.store(true, std::memory_order_relaxed);
+		if (is_enabled && !is_in_frame)
+			glutPostRedisplay();
+	}
+
+	// Setter helper: assigns and marks the scene dirty if the value changed
+	template <typename T>
+	static void assign(T& field, const T& value) {
+		if (field != value) {
+			field = value;
+			mark_dirty();
+		}
+	}
+
+	// Something will change in seconds from now, even if nobody calls mark_dirty()
+	static void schedule_in(double seconds) {
+		clock::time_point time = clock::now() + std::chrono::duration_cast<clock::duration>(
+			std::chrono::duration<double>(seconds > 0.0 ? seconds : 0.0));
+		clock::rep ticks = time.time_since_epoch().count();
+
+		clock::rep current = scheduled_ticks.load(std::memory_order_relaxed);
+		while (ticks < current && !scheduled_ticks.compare_exchange_weak(current, ticks, std::memory_order_relaxed)) {}
+	}
+
+	static void begin_frame() {
+		is_in_frame = true;
+		is_dirty.store(false, std::memory_order_relaxed);
+		if (scheduled_ticks.load(std::memory_order_relaxed) <= clock::now().time_since_epoch().count())
+			scheduled_ticks.store(no_schedule, std::memory_order_relaxed);
+		frames_drawn++;
+	}
+
+	// Decides whether and when the loop runs again
+	static void end_frame() {
+		is_in_frame = false;
+
+		if (!is_enabled)
+			return;
+
+		if (is_dirty.load(std::memory_order_relaxed)) {
+			glutPostRedisplay();
+			return;
+		}
+
+		clock::rep ticks = scheduled_ticks.load(std::memory_order_relaxed);
+		if (ticks == no_schedule)
+			return;
+		clock::time_point scheduled_time = clock::time_point(clock::duration(ticks));
+
+		// A timer already set for the same time or earlier will do
+		if (is_timer_armed && timer_time <= scheduled_time)
+			return;
+
+		// Rounded up, a timer that fires early only costs an extra wakeup
+		long long wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+			scheduled_time - clock::now() + std::chrono::milliseconds(1)).count();
+		unsigned int milliseconds = wait > 0 ? static_cast<unsigned int>(wait) : 0;
+
+		glutTimerFunc(milliseconds, on_timer, 0);
+		is_timer_armed = true;
+		timer_time = scheduled_time;
+	}
+
+	static bool get_is_dirty() { return is_dirty.load(std::memory_order_relaxed); }
+	static unsigned int get_frames_drawn() { return frames_drawn; }
+
+private:
+	static void on_timer(int) {
+		is_timer_armed = false;
+		glutPostRedisplay();
+	}
+};
+
+bool Redraw::is_enabled = false;
+std::atomic<bool> Redraw::is_dirty(true);
+bool Redraw::is_in_frame = false;
+
+const Redraw::clock::rep Redraw::no_schedule;
+std::atomic<Redraw::clock::rep> Redraw::scheduled_ticks(Redraw::no_schedule);
+
+bool Redraw::is_timer_armed = false;
+Redraw::clock::time_point Redraw::timer_time;
+
+unsigned int Redraw::frames_drawn = 0;
@@ -0,0 +1,257 @@
+#pragma once
+#include "SpriteBatch.h"
+#include "PrimitiveInstancer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Draw commands are recorded during the frame, sorted once by a 64-bit key
+// and then replayed so that neighbouring commands share as much state as
+// possible.
+//
+// Key layout, most significant first:
+//   8 bits  layer        explicit z-layer, always respected
+//   2 bits  blend mode   opaque sprites, transparent sprites, primitives
+//  22 bits  texture id
+//  32 bits  depth        order inside a layer/blend/texture group
+//
+// Objects in the same layer but with different textures may be reordered
+// relative to each other, so anything that must overlap in a fixed order
+// belongs in separate layers.
+class RenderQueue {
+public:
+	enum blend_mode {
+		blend_opaque = 0,
+		blend_transparent = 1,
+		blend_primitive = 2
+	};
+
+	// Layers above this are drawn as this one
+	static const unsigned int max_layer = 0xFF;
+
+private:
+	struct sort_entry {
+		std::uint64_t key;
+		std::uint32_t index;
+	};
+
+	struct sprite_command {
+		GLuint texture;
+		GLboolean is_transparent;
+		glm::vec2 corners[4];
+		glm::vec2 tex_coords[4];
+		glm::vec4 tint;
+	};
+
+	struct primitive_command {
+		primitive_type type;
+		int segments;
+		glm::mat3 transform;
+		glm::vec3 line;
+		glm::vec3 fill;
+	};
+
+	std::vector<sort_entry> entries;
+	std::vector<sort_entry> scratch;
+	std::vector<sprite_command> sprite_commands;
+	std::vector<primitive_command> primitive_commands;
+
+	// Below this std::stable_sort beats eight radix passes
+	std::size_t radix_threshold;
+
+	unsigned int state_switches;
+
+public:
+	RenderQueue() : radix_threshold(512), state_switches(0) {}
+
+	void begin() {
+		entries.clear();
+		sprite_commands.clear();
+		primitive_commands.clear();
+		state_switches = 0;
+	}
+
+	void submit_sprite(unsigned int layer, GLfloat depth, GLuint texture, GLboolean is_transparent,
+		const glm::vec2 corners[4], const glm::vec2 tex_coords[4], const glm::vec4& tint) {
+
+		sprite_command command;
+		command.texture = texture;
+		command.is_transparent = is_transparent;
+		for (int i = 0; i < 4; i++) {
+			command.corners[i] = corners[i];
+			command.tex_coords[i] = tex_coords[i];
+		}
+		command.tint = tint;
+
+		sort_entry entry;
+		entry.key = make_key(layer, is_transparent ? blend_transparent : blend_opaque, texture, depth);
+		entry.index = static_cast<std::uint32_t>(sprite_commands.size());
+		entries.push_back(entry);
+
+		sprite_commands.push_back(command);
+	}
+
+	void submit_primitive(unsigned int layer, GLfloat depth, primitive_type type, int segments,
+		const glm::vec2& position, GLfloat rotation, const glm::vec2& scale,
+		const glm::vec3& line, const glm::vec3& fill) {
+
+		submit_primitive(layer, depth, type, segments, Transform2D::make(position, rotation, scale), line, fill);
+	}
+
+	// transform maps the unit shape to the world, as for PrimitiveInstancer::draw
+	void submit_primitive(unsigned int layer, GLfloat depth, primitive_type type, int segments,
+		const glm::mat3& transform, const glm::vec3& line, const glm::vec3& fill) {
+
+		if (type == primitive_type::none)
+			return;
+
+		primitive_command command;
+		command.type = type;
+		command.segments = segments;
+		command.transform = transform;
+		command.line = line;
+		command.fill = fill;
+
+		// Shape goes where the texture would, so equal shapes end up adjacent
+		GLuint shape = static_cast<GLuint>(type) * 1024 + static_cast<GLuint>(segments);
+
+		sort_entry entry;
+		entry.key = make_key(layer, blend_primitive, shape, depth);
+		entry.index = static_cast<std::uint32_t>(primitive_commands.size());
+		entries.push_back(entry);
+
+		primitive_commands.push_back(command);
+	}
+
+	// Adds the commands of another queue as if they had been submitted here
+	void append(const RenderQueue& other) {
+		std::uint32_t sprite_offset = static_cast<std::uint32_t>(sprite_commands.size());
+		std::uint32_t primitive_offset = static_cast<std::uint32_t>(primitive_commands.size());
+
+		sprite_commands.insert(sprite_commands.end(), other.sprite_commands.begin(), other.sprite_commands.end());
+		primitive_commands.insert(primitive_commands.end(), other.primitive_commands.begin(), other.primitive_commands.end());
+
+		entries.reserve(entries.size() + other.entries.size());
+		for (sort_entry entry : other.entries) {
+			entry.index += get_blend_mode(entry.key) == blend_primitive ? primitive_offset : sprite_offset;
+			entries.push_back(entry);
+		}
+	}
+
+	void execute(SpriteBatch& batch, PrimitiveInstancer& instancer) {
+		sort();
+
+		batch.begin();
+		instancer.begin();
+
+		bool drawing_primitives = false;
+		unsigned int layer = entries.empty() ? 0 : get_layer(entries.front().key);
+
+		for (const sort_entry& entry : entries) {
+			bool is_primitive = get_blend_mode(entry.key) == blend_primitive;
+
+			// The instancer draws grouped by shape, so it is flushed at every
+			// layer boundary too, or a higher layer could end up underneath
+			if (is_primitive != drawing_primitives || get_layer(entry.key) != layer) {
+				if (drawing_primitives)
+					instancer.end();
+				else
+					batch.flush();
+				drawing_primitives = is_primitive;
+				layer = get_layer(entry.key);
+				state_switches++;
+			}
+
+			if (is_primitive) {
+				const primitive_command& command = primitive_commands[entry.index];
+				instancer.draw(command.type, command.segments, command.transform, command.line, command.fill);
+			}
+			else {
+				const sprite_command& command = sprite_commands[entry.index];
+				batch.draw(command.texture, command.is_transparent, command.corners, command.tex_coords, command.tint);
+			}
+		}
+
+		batch.end();
+		instancer.end();
+	}
+
+	unsigned int get_command_count() const { return static_cast<unsigned int>(entries.size()); }
+	// Flushes of the sprite batch or the instancer during execute(), when
+	// switching between them or moving on to the next layer
+	unsigned int get_state_switches() const { return state_switches; }
+
+	std::size_t get_radix_threshold() const { return radix_threshold; }
+	void set_radix_threshold(const std::size_t radix_threshold) { this->radix_threshold = radix_threshold; }
+
+	static std::uint64_t make_key(unsigned int layer, blend_mode blend, GLuint texture, GLfloat depth) {
+		return (static_cast<std::uint64_t>(std::min(layer, max_layer)) << 56) |
+			(static_cast<std::uint64_t>(blend & 0x3) << 54) |
+			(static_cast<std::uint64_t>(texture & 0x3FFFFF) << 32) |
+			static_cast<std::uint64_t>(depth_bits(depth));
+	}
+
+	static unsigned int get_layer(std::uint64_t key) {
+		return static_cast<unsigned int>(key >> 56);
+	}
+
+	static blend_mode get_blend_mode(std::uint64_t key) {
+		return static_cast<blend_mode>((key >> 54) & 0x3);
+	}
+
+private:
+	// Maps a float onto an unsigned integer with the same ordering
+	static std::uint32_t depth_bits(GLfloat depth) {
+		std::uint32_t bits;
+		std::memcpy(&bits, &depth, sizeof(bits));
+		return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+	}
+
+	void sort() {
+		if (entries.size() < radix_threshold) {
+			std::stable_sort(entries.begin(), entries.end(),
+				[](const sort_entry& a, const sort_entry& b) { return a.key < b.key; });
+			return;
+		}
+
+		radix_sort();
+	}
+
+	// LSD radix sort, one byte per pass. Stable, so commands with equal keys
+	// keep their submission order. Passes where every key has the same byte
+	// are skipped, which is most of them for typical scenes.
+	void radix_sort() {
+		std::size_t count = entries.size();
+		scratch.resize(count);
+
+		sort_entry* source = entries.data();
+		sort_entry* destination = scratch.data();
+
+		for (int shift = 0; shift < 64; shift += 8) {
+			std::size_t histogram[256] = { 0 };
+			for (std::size_t i = 0; i < count; i++)
+				histogram[(source[i].key >> shift) & 0xFF]++;
+
+			if (histogram[(source[0].key >> shift) & 0xFF] == count)
+				continue;
+
+			std::size_t offset = 0;
+			for (int digit = 0; digit < 256; digit++) {
+				std::size_t digit_count = histogram[digit];
+				histogram[digit] = offset;
+				offset += digit_count;
+			}
+
+			for (std::size_t i = 0; i < count; i++)
+				destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+
+			std::swap(source, destination);
+		}
+
+		if (source != entries.data())
+			std::copy(source, source + count, entries.data());
+	}
+};
+
+const unsigned int RenderQueue::max_layer;
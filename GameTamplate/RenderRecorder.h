@@ -0,0 +1,125 @@
+#pragma once
+#include "GameObject.h"
+#include "RenderQueue.h"
+#include "ViewCulling.h"
+#include "JobSystem.h"
+
+#include <vector>
+
+// Records the draw commands of many GameObjects on the JobSystem's threads.
+// Every job turns one contiguous slice of the objects into its own
+// RenderQueue (culling, sprite corners, UVs); the calling thread then
+// appends the queues in slice order, so the commands come out exactly as a
+// serial loop would have submitted them. No GL call is made off the calling
+// thread.
+//
+// Objects must not be changed while record() runs, which is the case as
+// long as update() and render() don't overlap.
+class RenderRecorder {
+private:
+	struct slice {
+		std::size_t first;
+		std::size_t last;
+		unsigned int tested;
+		unsigned int culled;
+	};
+
+	JobSystem& job_system;
+	std::size_t min_slice_size;
+
+	// One per slice, kept between frames so their storage is reused
+	std::vector<RenderQueue> queues;
+	std::vector<slice> slices;
+
+	const std::vector<GameObject*>* objects;
+
+	unsigned int slices_used;
+
+public:
+	RenderRecorder(JobSystem& job_system, std::size_t min_slice_size = 256)
+		: job_system(job_system), min_slice_size(glm::max<std::size_t>(1, min_slice_size)), objects(nullptr),
+		slices_used(0) {}
+
+	RenderRecorder(const RenderRecorder&) = delete;
+	RenderRecorder& operator=(const RenderRecorder&) = delete;
+
+	// Submits every visible object in view to the queue, in order
+	void record(const std::vector<GameObject*>& scene, RenderQueue& queue) {
+		// Serially, since children read their parents' matrices
+		for (GameObject* object : scene)
+			object->update_transform();
+
+		std::size_t count = scene.size();
+		std::size_t threads = job_system.get_is_serial() ? 1 : job_system.get_thread_count();
+		std::size_t used = glm::min<std::size_t>(threads, count / min_slice_size);
+
+		objects = &scene;
+
+		if (used <= 1) {
+			// Too little work to be worth splitting
+			slices_used = 1;
+			slice whole = { 0, count, 0, 0 };
+			record_slice(whole, queue);
+			ViewCulling::add_results(whole.tested, whole.culled);
+			return;
+		}
+
+		slices_used = static_cast<unsigned int>(used);
+		if (queues.size() < used) {
+			queues.resize(used);
+			slices.resize(used);
+		}
+
+		std::size_t per_slice = (count + used - 1) / used;
+		for (std::size_t i = 0; i < used; i++) {
+			slices[i].first = glm::min(count, i * per_slice);
+			slices[i].last = glm::min(count, (i + 1) * per_slice);
+		}
+
+		job_system.parallel_for(0, used, 1, [this](std::size_t first, std::size_t last) {
+			for (std::size_t i = first; i < last; i++) {
+				queues[i].begin();
+				record_slice(slices[i], queues[i]);
+			}
+		});
+
+		for (std::size_t i = 0; i < used; i++) {
+			queue.append(queues[i]);
+			ViewCulling::add_results(slices[i].tested, slices[i].culled);
+		}
+	}
+
+	// Slices the last record() was split into
+	unsigned int get_slices_used() const { return slices_used; }
+
+	std::size_t get_min_slice_size() const { return min_slice_size; }
+	void set_min_slice_size(const std::size_t min_slice_size) { this->min_slice_size = glm::max<std::size_t>(1, min_slice_size); }
+
+private:
+	// What GameObject::render(RenderQueue&) does, with the culling counters
+	// kept per slice instead of in ViewCulling
+	void record_slice(slice& s, RenderQueue& queue) {
+		s.tested = 0;
+		s.culled = 0;
+
+		bool is_culling = ViewCulling::get_is_enabled();
+		glm::vec2 min, max;
+
+		for (std::size_t i = s.first; i < s.last; i++) {
+			const GameObject* object = (*objects)[i];
+			if (!object->get_is_visible())
+				continue;
+
+			if (is_culling) {
+				object->get_bounds(min, max);
+				s.tested++;
+				if (!ViewCulling::overlaps(min, max)) {
+					s.culled++;
+					continue;
+				}
+			}
+
+			object->submit(queue);
+		}
+	}
+};
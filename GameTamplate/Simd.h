@@ -0,0 +1,19 @@
+#pragma once
+
+// Instruction sets the batch kernels can use. Detected from the compiler
+// flags (/arch:AVX2, -mavx2, ...); every kernel keeps a scalar path for
+// whatever is left over or when none of these are available.
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
@@ -1,26 +1,119 @@
 #include "GameObject.h"
+#include "RenderRecorder.h"
+#include "Entity.h"
+#include "Pool.h"
+#include "JobSystem.h"
+#include "SpatialHash.h"
+#include "AabbTree.h"
+#include "ContinuousCollision.h"
+#include "StaticLayer.h"
+#include "Tilemap.h"
+#include "ParticleSystem.h"
+#include "TextRenderer.h"
+#include "OffscreenTarget.h"
+#include "FixedTimestep.h"
+#include "FrameLimiter.h"
 #include "Input.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 
 float delta_time;
-int previous_time;
+FixedTimestep::clock::time_point previous_time;
+
+// Simulation runs at a fixed rate and rendering blends between the last two steps
+bool use_fixed_timestep = true;
+FixedTimestep timestep(60.0);
+FrameLimiter frame_limiter(60.0);
+
+// Set by --on-demand: frames are drawn only after something changed, for editors and tools
+bool use_redraw_on_demand = false;
+// Keeps a key press after a long pause from moving the player by the whole pause.
+// Matches the default animation delay, so animation timers still land in one step.
+const float max_on_demand_step = 0.25f;
 
 int window_width = 800;
 int window_height = 500;
 
 GameObject* player;
 
+// Everything drawn through the render queue, player included
+std::vector<GameObject*> game_objects;
+
+// Large numbers of simple objects go here instead of new GameObject
+EntityStore entity_store;
+
+// Short-lived objects (projectiles, effects) are spawned from pools and
+// referred to by handle. Pooled objects don't own their pooled sprites:
+// object_pool.spawn(position, velocity, sprite_pool.get(h), (GLboolean)false)
+Pool<GameObject> object_pool;
+Pool<Sprite> sprite_pool;
+
+// game_objects plus the live pooled objects, rebuilt every frame
+std::vector<GameObject*> render_list;
+std::vector<GameObject*> update_list;
+
+// Object updates are split across cores once there are enough of them.
+// Objects updated in parallel must not share a Sprite.
+JobSystem job_system;
+const std::size_t update_grain = 512;
+
+// Objects that take part in collisions are added here; after every step
+// collision_pairs holds each pair whose boxes overlap, and contacts the
+// pairs whose primitives actually touch and sprite_hits those whose
+// sprites' opaque pixels do
+SpatialHash spatial_hash;
+std::vector<SpatialHash::object_pair> collision_pairs;
+Narrowphase narrowphase;
+std::vector<contact> contacts;
+std::vector<SpatialHash::object_pair> sprite_hits;
+
+// Objects that can be clicked on or found by region and ray queries. Fast
+// movers are swept against it so they cannot pass through thin objects.
+AabbTree object_tree;
+ContinuousCollision continuous_collision;
+std::vector<impact> impacts;
+
+SpriteBatch sprite_batch;
+bool use_sprite_batch = true;
+
+PrimitiveInstancer primitive_instancer;
+bool use_instancing = true;
+
+RenderQueue render_queue;
+bool use_render_queue = true;
+
+// Builds the queue on job_system's threads once there are enough objects
+RenderRecorder render_recorder(job_system);
+
+// Backgrounds and other objects that never move go here instead of render()
+StaticLayer background_layer;
+
+// Set by --headless: frames go into an offscreen buffer and are never presented
+bool is_headless = false;
+OffscreenTarget offscreen_target;
+std::vector<unsigned char> frame_pixels;
+
 void initialize() {
 	player = new GameObject(
 		glm::vec2(0.0f),
 		glm::vec2(0.0f),
-		new Sprite("Sprites/player.png", glm::vec2(26, 22), 1, glm::vec2(8, 1), (GLboolean)false)
+		new Sprite("Sprites/player.png", glm::vec2(26, 22), 1, glm::vec2(8, 1), (GLboolean)false, (GLboolean)true)
 	);
+	game_objects.push_back(player);
+	spatial_hash.add(player);
+	object_tree.add(player);
 }
 
 void update(float dt) {
-	
+
+	for (GameObject* object : game_objects)
+		object->store_previous_state();
+	entity_store.store_previous_state();
+	object_pool.for_each([](GameObject& object) { object.store_previous_state(); });
+
 	if (Input::get_key('A')) {
 		float new_x = player->get_position().x;
 		new_x -= 300.0f * dt;
@@ -34,30 +127,110 @@ void update(float dt) {
 		player->get_sprite()->set_sprite_flip(glm::vec2(false, false));
 	}
 
-	player->update(dt);
+	entity_store.update(dt, Boundary::get_world_min(), Boundary::get_world_max());
+	entity_store.destroy_killed();
+
+	update_list.assign(game_objects.begin(), game_objects.end());
+	object_pool.collect(update_list);
+	job_system.parallel_for(0, update_list.size(), update_grain, [dt](std::size_t first, std::size_t last) {
+		for (std::size_t i = first; i < last; i++)
+			update_list[i]->update(dt);
+	});
+	object_pool.despawn_if([](GameObject& object) { return object.get_is_killed(); });
+
+	object_tree.update();
+	impacts.clear();
+	continuous_collision.resolve(update_list, object_tree, impacts);
+
+	spatial_hash.update();
+	collision_pairs.clear();
+	spatial_hash.find_pairs(collision_pairs);
+	contacts.clear();
+	narrowphase.collide(collision_pairs, contacts);
+	sprite_hits.clear();
+	narrowphase.collide_sprites(collision_pairs, sprite_hits);
 
 	Input::update();
 }
 
 void render() {
 
+	GLState::begin_frame();
+	ViewCulling::begin_frame();
+
 	//Cistimo sve piksele
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	player->render();
+	background_layer.render(window_width, window_height);
+
+	if (use_render_queue) {
+		render_queue.begin();
+		render_list.assign(game_objects.begin(), game_objects.end());
+		object_pool.collect(render_list);
+		render_recorder.record(render_list, render_queue);
+		entity_store.record(render_queue);
+		render_queue.execute(sprite_batch, primitive_instancer);
+	}
+	else if (use_sprite_batch && use_instancing) {
+		sprite_batch.begin();
+		primitive_instancer.begin();
+		player->render(sprite_batch, primitive_instancer);
+		sprite_batch.end();
+		primitive_instancer.end();
+	}
+	else if (use_sprite_batch) {
+		sprite_batch.begin();
+		player->render(sprite_batch);
+		sprite_batch.end();
+	}
+	else {
+		player->render();
+	}
 
 	//Menjamo bafer
-	glutSwapBuffers();
+	if (!is_headless)
+		glutSwapBuffers();
+
+	// Objects despawned during the frame go away only now
+	object_pool.flush_despawns();
+	sprite_pool.flush_despawns();
 
 }
 
 void game_loop(void) {
-	int current_time = glutGet(GLUT_ELAPSED_TIME);
-	delta_time = (float)(current_time - previous_time) / 1000;
-	previous_time = current_time;
+	if (use_redraw_on_demand) {
+		Redraw::begin_frame();
+
+		// The loop may have been idle for a while, so the step is capped
+		FixedTimestep::clock::time_point current_time = FixedTimestep::clock::now();
+		delta_time = glm::min(std::chrono::duration<float>(current_time - previous_time).count(), max_on_demand_step);
+		previous_time = current_time;
 
-	update(delta_time);
-	render();
+		update(delta_time);
+		render();
+
+		// Posts the next redisplay only if this frame left work behind
+		Redraw::end_frame();
+		return;
+	}
+
+	if (use_fixed_timestep) {
+		int steps = timestep.advance();
+		for (int i = 0; i < steps; i++)
+			update(timestep.get_step());
+
+		GameObject::set_interpolation(timestep.get_alpha());
+		render();
+		frame_limiter.wait();
+	}
+	else {
+		FixedTimestep::clock::time_point current_time = FixedTimestep::clock::now();
+		delta_time = std::chrono::duration<float>(current_time - previous_time).count();
+		previous_time = current_time;
+
+		update(delta_time);
+		render();
+	}
 
 	glutPostRedisplay();
 
@@ -65,11 +238,11 @@ void game_loop(void) {
 
 void init_game(void) {
 	glClearColor(100.0 / 255.0, 100.0 / 255.0, 100.0 / 255.0, 0.0);
-	glEnable(GL_TEXTURE_2D);
-	glEnable(GL_BLEND);
+	GLState::enable(GL_TEXTURE_2D);
+	GLState::enable(GL_BLEND);
 	glShadeModel(GL_SMOOTH);
 	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 void reshape(int w, int h) {
@@ -80,27 +253,107 @@ void reshape(int w, int h) {
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
 	gluOrtho2D(0.0, w, 0.0, h);
+	ViewCulling::set_view(glm::vec2(0.0f), glm::vec2(w, h));
+	Boundary::set_world(glm::vec2(0.0f), glm::vec2(w, h));
+	Redraw::mark_dirty();
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 }
 
+// Runs update/render with a fixed step as fast as the GL implementation
+// allows. With an output prefix every frame is saved as <prefix>0000.bmp,
+// otherwise the last frame is only read back into frame_pixels.
+void run_headless(int frame_count, const char* output_prefix) {
+	if (!offscreen_target.create(window_width, window_height)) {
+		std::cout << "Headless mode: could not create an offscreen target" << std::endl;
+		return;
+	}
+	reshape(offscreen_target.get_width(), offscreen_target.get_height());
+
+	const float step = 1.0f / 60.0f;
+	char file_name[512];
+
+	int start_time = glutGet(GLUT_ELAPSED_TIME);
+
+	for (int frame = 0; frame < frame_count; frame++) {
+		update(step);
+		render();
+
+		if (output_prefix) {
+			snprintf(file_name, sizeof(file_name), "%s%04d.bmp", output_prefix, frame);
+			if (!offscreen_target.save(file_name))
+				std::cout << "Could not save " << file_name << std::endl;
+		}
+		else {
+			offscreen_target.read_pixels(frame_pixels);
+		}
+	}
+
+	glFinish();
+	int elapsed = glutGet(GLUT_ELAPSED_TIME) - start_time;
+	std::cout << frame_count << " frames in " << elapsed << " ms" << std::endl;
+}
+
+// GameTamplate [--headless <frames>] [--size <width>x<height>] [--output <prefix>] [--on-demand]
 int main(int argc, char** argv) {
 
 	glutInit(&argc, argv);
 
+	int headless_frames = 0;
+	const char* output_prefix = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--on-demand")) {
+			use_redraw_on_demand = true;
+		}
+		else if (!strcmp(argv[i], "--serial")) {
+			job_system.set_is_serial(true);
+		}
+		else if (i + 1 == argc) {
+			break;
+		}
+		else if (!strcmp(argv[i], "--headless")) {
+			headless_frames = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--size")) {
+			char* end = nullptr;
+			window_width = static_cast<int>(strtol(argv[++i], &end, 10));
+			if (*end == 'x')
+				window_height = static_cast<int>(strtol(end + 1, nullptr, 10));
+		}
+		else if (!strcmp(argv[i], "--output")) {
+			output_prefix = argv[++i];
+		}
+	}
+	is_headless = headless_frames > 0;
+
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
 	glutInitWindowSize(window_width, window_height);
 	glutInitWindowPosition(50, 50);
 	glutCreateWindow("Tamplate!");
 
+	// The window only provides the context
+	if (is_headless)
+		glutHideWindow();
+
 	init_game();
 
+	if (is_headless) {
+		initialize();
+		run_headless(headless_frames, output_prefix);
+		return 0;
+	}
+
 	Input::set_callback_functions();
+	Input::set_pick_tree(&object_tree);
 	initialize();
 
 	glutDisplayFunc(game_loop);
 	glutReshapeFunc(reshape);
 
+	previous_time = FixedTimestep::clock::now();
+	Redraw::set_is_enabled(use_redraw_on_demand);
+
 	glutMainLoop();
 
 
@@ -0,0 +1,307 @@
+#pragma once
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include "GameObject.h"
+
+#include <gtx/hash.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Broadphase over a uniform grid of square cells, stored sparsely in a
+// hash map keyed by cell coordinates. Each object is listed in every cell
+// its bounding box touches, so objects can only collide with what shares
+// a cell with them and the cost stays close to linear in object count.
+//
+// Objects are added once and then kept in step by update(), which only
+// touches the map for objects whose box moved into a different range of
+// cells. Pick a cell size around the size of a typical object: much
+// smaller and big objects fill many cells, much larger and cells get
+// crowded.
+class SpatialHash {
+public:
+	typedef std::uint32_t proxy;
+	static const proxy null_proxy = 0xFFFFFFFF;
+
+	typedef std::pair<GameObject*, GameObject*> object_pair;
+
+private:
+	struct proxy_data {
+		GameObject* object;
+		glm::vec2 min;
+		glm::vec2 max;
+		glm::ivec2 cell_min;
+		glm::ivec2 cell_max;
+		unsigned int query_stamp;
+		bool is_used;
+	};
+
+	struct cell {
+		glm::ivec2 key;
+		std::vector<proxy> members;
+	};
+
+	float cell_size;
+	float inverse_cell_size;
+
+	// Cells live in one array, which find_pairs() walks front to back; the
+	// hash map only finds a cell's slot from its coordinates
+	std::unordered_map<glm::ivec2, std::uint32_t> cell_index;
+	std::vector<cell> cells;
+	std::vector<proxy_data> proxies;
+	std::vector<proxy> free_proxies;
+	std::size_t proxy_count;
+
+	unsigned int query_stamp;
+	unsigned int cells_changed;
+
+public:
+	SpatialHash(float cell_size = 64.0f)
+		: cell_size(cell_size), inverse_cell_size(1.0f / cell_size), proxy_count(0), query_stamp(0), cells_changed(0) {}
+
+	SpatialHash(const SpatialHash&) = delete;
+	SpatialHash& operator=(const SpatialHash&) = delete;
+
+	// The handle stays valid until remove(); remove objects before deleting
+	// or despawning them
+	proxy add(GameObject* object) {
+		glm::vec2 min, max;
+		object->get_collision_bounds(min, max);
+
+		proxy p;
+		if (!free_proxies.empty()) {
+			p = free_proxies.back();
+			free_proxies.pop_back();
+		}
+		else {
+			p = static_cast<proxy>(proxies.size());
+			proxies.push_back(proxy_data());
+		}
+
+		proxy_data& data = proxies[p];
+		data.object = object;
+		data.min = min;
+		data.max = max;
+		data.cell_min = get_cell(min);
+		data.cell_max = get_cell(max);
+		data.query_stamp = 0;
+		data.is_used = true;
+		insert_cells(p, data.cell_min, data.cell_max);
+
+		proxy_count++;
+		return p;
+	}
+
+	void remove(proxy p) {
+		if (!is_valid(p))
+			return;
+
+		proxy_data& data = proxies[p];
+		erase_cells(p, data.cell_min, data.cell_max);
+		data.object = nullptr;
+		data.is_used = false;
+		free_proxies.push_back(p);
+		proxy_count--;
+	}
+
+	bool is_valid(proxy p) const { return p < proxies.size() && proxies[p].is_used; }
+	GameObject* get_object(proxy p) const { return is_valid(p) ? proxies[p].object : nullptr; }
+
+	// Re-reads every object's collision bounds; once per step, after movement
+	void update() {
+		cells_changed = 0;
+		for (proxy p = 0; p < proxies.size(); p++) {
+			if (!proxies[p].is_used)
+				continue;
+
+			glm::vec2 min, max;
+			proxies[p].object->get_collision_bounds(min, max);
+			set_bounds(p, min, max);
+		}
+
+		if (cells.size() > 2 * proxy_count + 1024)
+			prune_empty_cells();
+	}
+
+	// Moves one proxy; the map is only touched if its cell range changed
+	void set_bounds(proxy p, const glm::vec2& min, const glm::vec2& max) {
+		if (!is_valid(p))
+			return;
+
+		proxy_data& data = proxies[p];
+		data.min = min;
+		data.max = max;
+
+		glm::ivec2 cell_min = get_cell(min);
+		glm::ivec2 cell_max = get_cell(max);
+		if (cell_min == data.cell_min && cell_max == data.cell_max)
+			return;
+
+		// Only the cells covered by one range and not the other change
+		for (int y = data.cell_min.y; y <= data.cell_max.y; y++) {
+			for (int x = data.cell_min.x; x <= data.cell_max.x; x++) {
+				if (!contains(cell_min, cell_max, x, y))
+					erase_cell(p, glm::ivec2(x, y));
+			}
+		}
+		for (int y = cell_min.y; y <= cell_max.y; y++) {
+			for (int x = cell_min.x; x <= cell_max.x; x++) {
+				if (!contains(data.cell_min, data.cell_max, x, y))
+					get_cell_members(glm::ivec2(x, y)).push_back(p);
+			}
+		}
+
+		data.cell_min = cell_min;
+		data.cell_max = cell_max;
+		cells_changed++;
+	}
+
+	// Every pair of objects whose boxes overlap, each pair once. Pairs are
+	// appended; the first object is the one added earlier (lower proxy).
+	void find_pairs(std::vector<object_pair>& pairs) const {
+		for (const cell& c : cells) {
+			const std::vector<proxy>& members = c.members;
+			std::size_t count = members.size();
+
+			for (std::size_t i = 0; i < count; i++) {
+				const proxy_data& a = proxies[members[i]];
+				for (std::size_t j = i + 1; j < count; j++) {
+					const proxy_data& b = proxies[members[j]];
+					if (!overlaps(a, b))
+						continue;
+
+					// Two boxes share a rectangle of cells; only its lowest
+					// cell reports them, so nothing needs a seen-set
+					glm::ivec2 first_shared = glm::max(a.cell_min, b.cell_min);
+					if (first_shared != c.key)
+						continue;
+
+					if (members[i] < members[j])
+						pairs.push_back(object_pair(a.object, b.object));
+					else
+						pairs.push_back(object_pair(b.object, a.object));
+				}
+			}
+		}
+	}
+
+	// Objects whose boxes overlap [min, max], each once
+	void query(const glm::vec2& min, const glm::vec2& max, std::vector<GameObject*>& results) {
+		query_stamp++;
+		glm::ivec2 cell_min = get_cell(min);
+		glm::ivec2 cell_max = get_cell(max);
+
+		for (int y = cell_min.y; y <= cell_max.y; y++) {
+			for (int x = cell_min.x; x <= cell_max.x; x++) {
+				auto found = cell_index.find(glm::ivec2(x, y));
+				if (found == cell_index.end())
+					continue;
+
+				for (proxy p : cells[found->second].members) {
+					proxy_data& data = proxies[p];
+					if (data.query_stamp == query_stamp)
+						continue;
+					data.query_stamp = query_stamp;
+
+					if (!(data.max.x < min.x || data.min.x > max.x || data.max.y < min.y || data.min.y > max.y))
+						results.push_back(data.object);
+				}
+			}
+		}
+	}
+
+	void clear() {
+		cell_index.clear();
+		cells.clear();
+		proxies.clear();
+		free_proxies.clear();
+		proxy_count = 0;
+	}
+
+	float get_cell_size() const { return cell_size; }
+	std::size_t get_count() const { return proxy_count; }
+	// Cells in use, including emptied ones not pruned yet
+	std::size_t get_cell_count() const { return cells.size(); }
+	// Proxies that changed cells during the last update()
+	unsigned int get_cells_changed() const { return cells_changed; }
+
+private:
+	glm::ivec2 get_cell(const glm::vec2& point) const {
+		return glm::ivec2(static_cast<int>(floor(point.x * inverse_cell_size)),
+			static_cast<int>(floor(point.y * inverse_cell_size)));
+	}
+
+	static bool contains(const glm::ivec2& min, const glm::ivec2& max, int x, int y) {
+		return x >= min.x && x <= max.x && y >= min.y && y <= max.y;
+	}
+
+	static bool overlaps(const proxy_data& a, const proxy_data& b) {
+		return !(a.max.x < b.min.x || a.min.x > b.max.x || a.max.y < b.min.y || a.min.y > b.max.y);
+	}
+
+	void insert_cells(proxy p, const glm::ivec2& cell_min, const glm::ivec2& cell_max) {
+		for (int y = cell_min.y; y <= cell_max.y; y++) {
+			for (int x = cell_min.x; x <= cell_max.x; x++)
+				get_cell_members(glm::ivec2(x, y)).push_back(p);
+		}
+	}
+
+	void erase_cells(proxy p, const glm::ivec2& cell_min, const glm::ivec2& cell_max) {
+		for (int y = cell_min.y; y <= cell_max.y; y++) {
+			for (int x = cell_min.x; x <= cell_max.x; x++)
+				erase_cell(p, glm::ivec2(x, y));
+		}
+	}
+
+	std::vector<proxy>& get_cell_members(const glm::ivec2& key) {
+		auto found = cell_index.find(key);
+		if (found != cell_index.end())
+			return cells[found->second].members;
+
+		cell_index[key] = static_cast<std::uint32_t>(cells.size());
+		cells.push_back(cell());
+		cells.back().key = key;
+		return cells.back().members;
+	}
+
+	// Swap-remove. Emptied cells are kept, so an object moving back and
+	// forth across a cell edge does not reallocate; update() drops them
+	// once they outnumber the proxies.
+	void erase_cell(proxy p, const glm::ivec2& key) {
+		auto found = cell_index.find(key);
+		if (found == cell_index.end())
+			return;
+
+		std::vector<proxy>& members = cells[found->second].members;
+		for (std::size_t i = 0; i < members.size(); i++) {
+			if (members[i] == p) {
+				members[i] = members.back();
+				members.pop_back();
+				break;
+			}
+		}
+	}
+
+	void prune_empty_cells() {
+		std::size_t i = 0;
+		while (i < cells.size()) {
+			if (!cells[i].members.empty()) {
+				i++;
+				continue;
+			}
+
+			cell_index.erase(cells[i].key);
+			if (i + 1 != cells.size()) {
+				cells[i] = std::move(cells.back());
+				cell_index[cells[i].key] = static_cast<std::uint32_t>(i);
+			}
+			cells.pop_back();
+		}
+	}
+};
+
+const SpatialHash::proxy SpatialHash::null_proxy;
@@ -4,12 +4,22 @@
 #include "SOIL2.h"
 #include "glut.h"
 #include "glm.hpp"
+#include "GLState.h"
+#include "Redraw.h"
+#include "CollisionMask.h"
 
 #include <iostream>
+#include <utility>
 
 class Sprite {
 private:
+	// Texture ids live inline unless a sprite has more separate images than
+	// this, so creating a sprite normally does not allocate
+	static const unsigned int inline_texture_count = 4;
+	GLuint inline_textures[inline_texture_count];
 	GLuint* textures;
+	unsigned int texture_capacity;
+
 	unsigned int texture_index;
 	unsigned int current_frame;
 	unsigned int number_of_textures;
@@ -23,33 +33,75 @@ private:
 
 	glm::vec2 sprite_flip;
 	glm::vec2 size;
+	glm::vec4 tint;
+
+	// Shared, owned by CollisionMask's cache; nullptr if none was requested
+	const CollisionMask* collision_mask;
 
 public:
-	Sprite() = default;
+	Sprite() : textures(inline_textures), texture_capacity(inline_texture_count), texture_index(0),
+		current_frame(0), number_of_textures(0), number_of_frames(1), animation_delay(0.25f),
+		animation_elapsed_time(0.0f), is_transparent(true), is_sprite_sheet(false),
+		sprite_flip(false), size(0.0f), tint(1.0f), collision_mask(nullptr) {}
+
 	Sprite(const char* file_name,
 		glm::vec2 size,
 		GLuint number_of_textures = 1,
 		glm::vec2 number_of_frames = glm::vec2(1),
-		GLboolean is_transparent = true) : size(size), number_of_frames(number_of_frames),
+		GLboolean is_transparent = true,
+		GLboolean has_collision_mask = false) : textures(inline_textures), texture_capacity(inline_texture_count),
+		size(size), number_of_frames(number_of_frames),
 		animation_delay(0.25f), animation_elapsed_time(0.0f),
-		is_transparent(is_transparent), sprite_flip(false) {
+		is_transparent(is_transparent), sprite_flip(false), tint(1.0f), collision_mask(nullptr) {
 
 		this->number_of_textures = static_cast<unsigned int>(number_of_frames.x * number_of_frames.y);
-		textures = new GLuint[this->number_of_textures];
 
 		texture_index = 0;
 		current_frame = 0;
 
 		if (!add_texture(file_name, is_transparent))
 			std::cout << "Texture loading failed: " << SOIL_last_result() << std::endl;
+
+		// The image is read a second time, on the CPU, only for sprites that ask
+		if (has_collision_mask) {
+			collision_mask = CollisionMask::load(file_name, number_of_frames);
+			if (!collision_mask)
+				std::cout << "Collision mask loading failed: " << SOIL_last_result() << std::endl;
+		}
+	}
+
+	// Shares a texture that is already loaded, so spawning e.g. a projectile
+	// costs no file IO. Sprites never delete their textures, so this is safe.
+	Sprite(GLuint texture,
+		glm::vec2 size,
+		glm::vec2 number_of_frames = glm::vec2(1),
+		GLboolean is_transparent = true) : textures(inline_textures), texture_capacity(inline_texture_count),
+		texture_index(1), current_frame(0), number_of_frames(number_of_frames),
+		animation_delay(0.25f), animation_elapsed_time(0.0f),
+		is_transparent(is_transparent), sprite_flip(false), size(size), tint(1.0f), collision_mask(nullptr) {
+
+		number_of_textures = static_cast<unsigned int>(number_of_frames.x * number_of_frames.y);
+		is_sprite_sheet = number_of_textures > 1;
+		textures[0] = texture;
+	}
+
+	~Sprite() {
+		if (textures != inline_textures)
+			delete[] textures;
 	}
 
+	Sprite(const Sprite&) = delete;
+	Sprite& operator=(const Sprite&) = delete;
+
 	const bool add_texture(const char* file_name, const bool use_transparency) {
 		GLuint texture = SOIL_load_OGL_texture(file_name, SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, 0);
+		// SOIL binds the new texture behind GLState's back
+		GLState::invalidate();
 
 		if (texture == 0)
 			return false;
 
+		reserve_textures(texture_index + 1);
 		textures[texture_index] = texture;
 		texture_index++;
 
@@ -67,24 +119,21 @@ public:
 			if (current_frame >= number_of_textures)
 				current_frame = 0;
 			animation_elapsed_time = 0.0f;
+			Redraw::mark_dirty();
 		}
-	}
-
-	void render() {
-		if (is_transparent) {
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		}
-
-		glBindTexture(GL_TEXTURE_2D, textures[0]);
-		glColor3f(1.0f, 1.0f, 1.0f);
 
-		GLfloat x = 0;
-		GLfloat y = 0;
+		// Wake up in time for the next frame change
+		if (number_of_textures > 1)
+			Redraw::schedule_in(animation_delay - animation_elapsed_time);
+	}
 
-		GLfloat w = size.x;
-		GLfloat h = size.y;
+	// Corner order matches the quad emitted by render(): (0,0), (w,0), (w,h), (0,h)
+	void get_tex_coords(glm::vec2 tex_coords[4]) const {
+		get_frame_tex_coords(current_frame, sprite_flip, tex_coords);
+	}
 
+	// Same as get_tex_coords for any frame of the sheet, e.g. tiles in a Tilemap
+	void get_frame_tex_coords(unsigned int frame, const glm::vec2& flip, glm::vec2 tex_coords[4]) const {
 		GLfloat texture_width = (GLfloat)texture_index / number_of_frames.x;
 		GLfloat texture_height = (GLfloat)texture_index / number_of_frames.y;
 
@@ -95,53 +144,68 @@ public:
 		GLfloat v = 0.0f;
 
 		if (texture_index < number_of_frames.x * number_of_frames.y) {
-			GLuint current_y = current_frame / number_of_frames.x;
-			GLuint current_x = current_frame - current_y * number_of_frames.x;
+			GLuint current_y = frame / number_of_frames.x;
+			GLuint current_x = frame - current_y * number_of_frames.x;
 
 			u = static_cast<GLfloat>(current_x) * texture_width;
 			v = static_cast<GLfloat>(current_y) * texture_height;
 		}
 
-		glBegin(GL_QUADS);
+		GLfloat u0 = u;
+		GLfloat u1 = u + texture_width;
+		GLfloat v0 = v + texture_height;
+		GLfloat v1 = v;
 
-		// Default
-		if (!sprite_flip.y && !sprite_flip.x) {
-			glTexCoord2f(u, v + texture_height);					glVertex2f(x, y);
-			glTexCoord2f(u + texture_width, v + texture_height);	glVertex2f(x + w, y);
-			glTexCoord2f(u + texture_width, v);						glVertex2f(x + w, y + h);
-			glTexCoord2f(u, v);										glVertex2f(x, y + h);
-		}
 		// Horizontal flip
-		if (sprite_flip.y && !sprite_flip.x) {
-			glTexCoord2f(u, v);										glVertex2f(x, y);
-			glTexCoord2f(u + texture_width, v);						glVertex2f(x + w, y);
-			glTexCoord2f(u + texture_width, v + texture_height);	glVertex2f(x + w, y + h);
-			glTexCoord2f(u, v + texture_height);					glVertex2f(x, y + h);
-		}
+		if (flip.y)
+			std::swap(v0, v1);
 		// Vertical flip
-		if (!sprite_flip.y && sprite_flip.x) {
-			glTexCoord2f(u + texture_width, v + texture_height);	glVertex2f(x, y);
-			glTexCoord2f(u, v + texture_height);					glVertex2f(x + w, y);
-			glTexCoord2f(u, v);										glVertex2f(x + w, y + h);
-			glTexCoord2f(u + texture_width, v);						glVertex2f(x, y + h);
-		}
-		// Horizontal && Vertical flip
-		if (sprite_flip.y && sprite_flip.x) {
-			glTexCoord2f(u + texture_width, v);						glVertex2f(x, y);
-			glTexCoord2f(u, v);										glVertex2f(x + w, y);
-			glTexCoord2f(u, v + texture_height);					glVertex2f(x + w, y + h);
-			glTexCoord2f(u + texture_width, v + texture_height);	glVertex2f(x, y + h);
+		if (flip.x)
+			std::swap(u0, u1);
+
+		tex_coords[0] = glm::vec2(u0, v0);
+		tex_coords[1] = glm::vec2(u1, v0);
+		tex_coords[2] = glm::vec2(u1, v1);
+		tex_coords[3] = glm::vec2(u0, v1);
+	}
+
+	void render() {
+		const glm::vec2 corners[4] = {
+			glm::vec2(0.0f, 0.0f),
+			glm::vec2(size.x, 0.0f),
+			glm::vec2(size.x, size.y),
+			glm::vec2(0.0f, size.y)
+		};
+		render(corners);
+	}
+
+	// The quad with its corners already in world space, no matrix stack needed
+	void render(const glm::vec2 corners[4]) {
+		if (is_transparent) {
+			GLState::enable(GL_BLEND);
+			GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		}
 
-		glEnd();
+		GLState::bind_texture(textures[0]);
+		GLState::set_color(tint.r, tint.g, tint.b, tint.a);
+
+		glm::vec2 tex_coords[4];
+		get_tex_coords(tex_coords);
 
-		glBindTexture(GL_TEXTURE_2D, 0);
+		glBegin(GL_QUADS);
+		for (int i = 0; i < 4; i++) {
+			glTexCoord2f(tex_coords[i].x, tex_coords[i].y);
+			glVertex2f(corners[i].x, corners[i].y);
+		}
+		glEnd();
 
 		if (is_transparent) {
-			glDisable(GL_BLEND);
+			GLState::disable(GL_BLEND);
 		}
 	}
 
+	GLuint get_texture() const { return textures[0]; }
+
 	GLuint* get_textures() const { return textures; }
 	void set_textures(const GLuint* textures) {
 		if (textures == nullptr) {
@@ -149,22 +213,24 @@ public:
 			return;
 		}
 
+		reserve_textures(number_of_textures);
 		for (unsigned int i = 0; i < number_of_textures; ++i) {
 			this->textures[i] = textures[i];
 		}
+		Redraw::mark_dirty();
 	}
 
 	unsigned int get_texture_index() const { return texture_index; }
-	void set_texture_index(const unsigned int& texture_index) { this->texture_index = texture_index; }
+	void set_texture_index(const unsigned int& texture_index) { Redraw::assign(this->texture_index, texture_index); }
 
 	unsigned int get_current_frame() const { return current_frame; }
-	void set_current_frame(const unsigned int& current_frame) { this->current_frame = current_frame; }
+	void set_current_frame(const unsigned int& current_frame) { Redraw::assign(this->current_frame, current_frame); }
 
 	unsigned int get_number_of_textures() const { return number_of_textures; }
 	void set_number_of_textures(const unsigned int& number_of_textures) { this->number_of_textures = number_of_textures; }
 
 	glm::vec2 get_number_of_frames() const { return number_of_frames; }
-	void set_number_of_frames(const glm::vec2& number_of_frames) { this->number_of_frames = number_of_frames; }
+	void set_number_of_frames(const glm::vec2& number_of_frames) { Redraw::assign(this->number_of_frames, number_of_frames); }
 
 	GLfloat get_animation_delay() const { return animation_delay; }
 	void set_animation_delay(const GLfloat& animation_delay) { this->animation_delay = animation_delay; }
@@ -173,16 +239,40 @@ public:
 	void set_animation_elapsed_time(const GLfloat& animation_elapsed_time) { this->animation_elapsed_time = animation_elapsed_time; }
 
 	GLboolean get_is_transparent() const { return is_transparent; }
-	void set_is_transparent(const GLboolean& is_transparent) { this->is_transparent = is_transparent; }
+	void set_is_transparent(const GLboolean& is_transparent) { Redraw::assign(this->is_transparent, is_transparent); }
 
 	GLboolean get_is_sprite_sheet() const { return is_sprite_sheet; }
-	void set_is_sprite_sheet(const GLboolean& is_sprite_sheet) { this->is_sprite_sheet = is_sprite_sheet; }
+	void set_is_sprite_sheet(const GLboolean& is_sprite_sheet) { Redraw::assign(this->is_sprite_sheet, is_sprite_sheet); }
 
 	glm::vec2 get_sprite_flip() const { return sprite_flip; }
-	void set_sprite_flip(const glm::vec2& sprite_flip) { this->sprite_flip = sprite_flip; }
+	void set_sprite_flip(const glm::vec2& sprite_flip) { Redraw::assign(this->sprite_flip, sprite_flip); }
 
 	glm::vec2 get_size() const { return size; }
-	void set_size(const glm::vec2& size) { this->size = size; }
+	void set_size(const glm::vec2& size) { Redraw::assign(this->size, size); }
+
+	glm::vec4 get_tint() const { return tint; }
+	void set_tint(const glm::vec4& tint) { Redraw::assign(this->tint, tint); }
+
+	// Sprites sharing a texture (e.g. from a Pool) can share the mask the same way
+	const CollisionMask* get_collision_mask() const { return collision_mask; }
+	void set_collision_mask(const CollisionMask* collision_mask) { this->collision_mask = collision_mask; }
+
+private:
+	void reserve_textures(unsigned int count) {
+		if (count <= texture_capacity)
+			return;
+
+		GLuint* grown = new GLuint[count];
+		for (unsigned int i = 0; i < texture_index; i++)
+			grown[i] = textures[i];
+
+		if (textures != inline_textures)
+			delete[] textures;
+		textures = grown;
+		texture_capacity = count;
+	}
 };
 
+const unsigned int Sprite::inline_texture_count;
+
 #endif #SPRITE_H
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+
+#include <glm.hpp>
+#include <vector>
+
+struct sprite_vertex {
+	GLfloat x, y;
+	GLfloat u, v;
+	GLfloat r, g, b, a;
+};
+
+// Collects sprite quads for a whole frame and draws them with one
+// glDrawArrays per run of quads that share a texture and blend state.
+class SpriteBatch {
+private:
+	struct batch_run {
+		GLuint texture;
+		GLboolean is_transparent;
+		GLint first;
+		GLsizei count;
+	};
+
+	std::vector<sprite_vertex> vertices;
+	std::vector<batch_run> runs;
+
+	StreamBuffer stream;
+
+	unsigned int sprites_submitted;
+	unsigned int draw_calls;
+
+public:
+	SpriteBatch() : sprites_submitted(0), draw_calls(0) {}
+
+	SpriteBatch(const SpriteBatch&) = delete;
+	SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+	void begin() {
+		stream.begin_frame();
+		vertices.clear();
+		runs.clear();
+		sprites_submitted = 0;
+		draw_calls = 0;
+	}
+
+	void draw(GLuint texture, GLboolean is_transparent,
+		const glm::vec2 corners[4], const glm::vec2 tex_coords[4], const glm::vec4& tint) {
+
+		if (runs.empty() || runs.back().texture != texture || runs.back().is_transparent != is_transparent) {
+			batch_run run;
+			run.texture = texture;
+			run.is_transparent = is_transparent;
+			run.first = static_cast<GLint>(vertices.size());
+			run.count = 0;
+			runs.push_back(run);
+		}
+
+		for (int i = 0; i < 4; i++) {
+			sprite_vertex vertex;
+			vertex.x = corners[i].x;
+			vertex.y = corners[i].y;
+			vertex.u = tex_coords[i].x;
+			vertex.v = tex_coords[i].y;
+			vertex.r = tint.r;
+			vertex.g = tint.g;
+			vertex.b = tint.b;
+			vertex.a = tint.a;
+			vertices.push_back(vertex);
+		}
+
+		runs.back().count += 4;
+		sprites_submitted++;
+	}
+
+	// Draws everything collected so far. Called by end(), and by anyone who
+	// needs to draw immediate-mode geometry on top of the batched sprites.
+	void flush() {
+		if (vertices.empty())
+			return;
+
+		const GLubyte* base = stream.write(vertices.data(), vertices.size() * sizeof(sprite_vertex));
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glVertexPointer(2, GL_FLOAT, sizeof(sprite_vertex), base + offsetof(sprite_vertex, x));
+		glTexCoordPointer(2, GL_FLOAT, sizeof(sprite_vertex), base + offsetof(sprite_vertex, u));
+		glColorPointer(4, GL_FLOAT, sizeof(sprite_vertex), base + offsetof(sprite_vertex, r));
+
+		GLState::enable(GL_TEXTURE_2D);
+
+		// Same blend handling as Sprite::render, one run at a time
+		for (const batch_run& run : runs) {
+			if (run.is_transparent) {
+				GLState::enable(GL_BLEND);
+				GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			}
+
+			GLState::bind_texture(run.texture);
+			glDrawArrays(GL_QUADS, run.first, run.count);
+			draw_calls++;
+
+			if (run.is_transparent) {
+				GLState::disable(GL_BLEND);
+			}
+		}
+
+		GLState::disable(GL_TEXTURE_2D);
+		GLState::invalidate_color();
+
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+
+		stream.unbind();
+
+		vertices.clear();
+		runs.clear();
+	}
+
+	void end() {
+		flush();
+	}
+
+	unsigned int get_sprites_submitted() const { return sprites_submitted; }
+	unsigned int get_draw_calls() const { return draw_calls; }
+	// Draw calls the immediate-mode path would have issued minus the ones we did
+	unsigned int get_draw_calls_saved() const { return sprites_submitted - draw_calls; }
+
+	const StreamBuffer& get_stream() const { return stream; }
+};
@@ -0,0 +1,239 @@
+#pragma once
+#include "GameObject.h"
+
+// A group of GameObjects that rarely change, drawn once into a texture
+// and composited as a single quad afterwards. Members are not owned.
+//
+// Without framebuffer objects the layer is drawn into the back buffer and
+// copied out with glCopyTexSubImage2D. That copy includes the clear
+// color, so in that mode the layer is opaque and must be the first thing
+// rendered after glClear.
+class StaticLayer {
+private:
+	struct member_state {
+		glm::vec2 position;
+		float rotation;
+		glm::vec2 scale;
+		GLboolean is_visible;
+		Sprite* sprite;
+		unsigned int current_frame;
+		glm::vec2 sprite_flip;
+	};
+
+	std::vector<GameObject*> members;
+	std::vector<member_state> states;
+
+	GLuint texture;
+	GLuint framebuffer;
+	int width;
+	int height;
+
+	GLboolean use_framebuffer;
+	GLboolean is_initialized;
+	GLboolean is_dirty;
+
+	unsigned int rebuild_count;
+
+public:
+	StaticLayer()
+		: texture(0), framebuffer(0), width(0), height(0), use_framebuffer(false),
+		is_initialized(false), is_dirty(true), rebuild_count(0) {}
+
+	~StaticLayer() {
+		if (framebuffer)
+			GLExtensions::delete_framebuffers(1, &framebuffer);
+		if (texture)
+			glDeleteTextures(1, &texture);
+	}
+
+	StaticLayer(const StaticLayer&) = delete;
+	StaticLayer& operator=(const StaticLayer&) = delete;
+
+	void add(GameObject* object) {
+		members.push_back(object);
+		states.push_back(capture(*object));
+		is_dirty = true;
+	}
+
+	void remove(GameObject* object) {
+		for (std::size_t i = 0; i < members.size(); i++) {
+			if (members[i] == object) {
+				members.erase(members.begin() + i);
+				states.erase(states.begin() + i);
+				is_dirty = true;
+				return;
+			}
+		}
+	}
+
+	void clear() {
+		members.clear();
+		states.clear();
+		is_dirty = true;
+	}
+
+	// Forces a rebuild for changes the snapshot does not see, e.g. a new tint
+	void invalidate() { is_dirty = true; }
+
+	// Rebuilds the cached texture if a member moved, changed frame or
+	// visibility, then draws it over the whole view.
+	void render(int view_width, int view_height) {
+		if (members.empty())
+			return;
+
+		if (!is_initialized)
+			initialize();
+
+		if (view_width != width || view_height != height)
+			resize(view_width, view_height);
+
+		detect_changes();
+
+		if (is_dirty)
+			rebuild();
+
+		composite();
+	}
+
+	const std::vector<GameObject*>& get_members() const { return members; }
+	GLuint get_texture() const { return texture; }
+	GLboolean get_use_framebuffer() const { return use_framebuffer; }
+	unsigned int get_rebuild_count() const { return rebuild_count; }
+
+private:
+	static member_state capture(const GameObject& object) {
+		member_state state;
+		state.position = object.get_position();
+		state.rotation = object.get_rotation();
+		state.scale = object.get_scale();
+		state.is_visible = object.get_is_visible();
+		state.sprite = object.get_sprite();
+		state.current_frame = state.sprite ? state.sprite->get_current_frame() : 0;
+		state.sprite_flip = state.sprite ? state.sprite->get_sprite_flip() : glm::vec2(0.0f);
+		return state;
+	}
+
+	static bool is_same(const member_state& a, const member_state& b) {
+		return a.position == b.position && a.rotation == b.rotation && a.scale == b.scale &&
+			a.is_visible == b.is_visible && a.sprite == b.sprite &&
+			a.current_frame == b.current_frame && a.sprite_flip == b.sprite_flip;
+	}
+
+	void detect_changes() {
+		for (std::size_t i = 0; i < members.size(); i++) {
+			member_state state = capture(*members[i]);
+			if (!is_same(state, states[i])) {
+				states[i] = state;
+				is_dirty = true;
+			}
+		}
+	}
+
+	void initialize() {
+		GLExtensions::load();
+		use_framebuffer = GLExtensions::has_framebuffers();
+		is_initialized = true;
+	}
+
+	void resize(int new_width, int new_height) {
+		width = new_width;
+		height = new_height;
+
+		if (!texture)
+			glGenTextures(1, &texture);
+
+		GLState::bind_texture(texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+		if (use_framebuffer) {
+			if (!framebuffer)
+				GLExtensions::gen_framebuffers(1, &framebuffer);
+
+			GLExtensions::bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+			GLExtensions::framebuffer_texture_2d(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+			if (GLExtensions::check_framebuffer_status(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				std::cout << "Static layer framebuffer incomplete, falling back to texture copies" << std::endl;
+				GLExtensions::bind_framebuffer(GL_FRAMEBUFFER, GLState::get_window_framebuffer());
+				GLExtensions::delete_framebuffers(1, &framebuffer);
+				framebuffer = 0;
+				use_framebuffer = false;
+			}
+			else {
+				GLExtensions::bind_framebuffer(GL_FRAMEBUFFER, GLState::get_window_framebuffer());
+			}
+		}
+
+		is_dirty = true;
+	}
+
+	void rebuild() {
+		if (use_framebuffer) {
+			GLExtensions::bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+
+			GLfloat clear_color[4];
+			glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+			glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+
+			// Alpha would otherwise be blended like the colors and come out squared
+			GLState::set_accumulate_alpha(true);
+			draw_members();
+			GLState::set_accumulate_alpha(false);
+
+			GLExtensions::bind_framebuffer(GL_FRAMEBUFFER, GLState::get_window_framebuffer());
+		}
+		else {
+			// The back buffer is cleared again afterwards, so nothing leaks into the frame
+			glClear(GL_COLOR_BUFFER_BIT);
+			draw_members();
+
+			GLState::bind_texture(texture);
+			glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+
+		is_dirty = false;
+		rebuild_count++;
+	}
+
+	void draw_members() {
+		for (GameObject* member : members)
+			member->render();
+	}
+
+	void composite() {
+		GLState::enable(GL_TEXTURE_2D);
+		GLState::bind_texture(texture);
+		GLState::set_color(1.0f, 1.0f, 1.0f, 1.0f);
+
+		if (use_framebuffer) {
+			// Members were blended onto transparent black, so the colors are premultiplied
+			GLState::enable(GL_BLEND);
+			GLState::blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		}
+		else {
+			GLState::disable(GL_BLEND);
+		}
+
+		GLfloat w = static_cast<GLfloat>(width);
+		GLfloat h = static_cast<GLfloat>(height);
+
+		glBegin(GL_QUADS);
+		glTexCoord2f(0.0f, 0.0f);	glVertex2f(0.0f, 0.0f);
+		glTexCoord2f(1.0f, 0.0f);	glVertex2f(w, 0.0f);
+		glTexCoord2f(1.0f, 1.0f);	glVertex2f(w, h);
+		glTexCoord2f(0.0f, 1.0f);	glVertex2f(0.0f, h);
+		glEnd();
+
+		GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GLState::disable(GL_BLEND);
+		GLState::disable(GL_TEXTURE_2D);
+	}
+};
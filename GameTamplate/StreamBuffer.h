@@ -0,0 +1,249 @@
+#pragma once
+#include "GLExtensions.h"
+
+#include <cstring>
+#include <vector>
+
+// Ring of three per-frame regions in one GL_ARRAY_BUFFER for vertex data
+// that is rebuilt every frame. Writes in a frame go to the current region;
+// begin_frame() fences it and moves on, so the CPU only ever waits when the
+// GPU is still reading a region from three frames ago.
+//
+// Uses the best path the context supports:
+//   persistent      glBufferStorage + one persistent coherent mapping (GL 4.4)
+//   unsynchronized  glMapBufferRange(UNSYNCHRONIZED) per write (GL 3.2)
+//   orphaning       glBufferData(nullptr) per frame + glBufferSubData
+//   client memory   no buffer objects at all, pointers go straight to GL
+class StreamBuffer {
+public:
+	enum stream_mode {
+		stream_persistent,
+		stream_unsynchronized,
+		stream_orphaning,
+		stream_client_memory
+	};
+
+	static const int region_count = 3;
+
+private:
+	stream_mode mode;
+	GLuint buffer;
+	GLubyte* mapped;
+
+	std::size_t region_size;
+	int region;
+	std::size_t region_offset;
+	GLExtensions::sync_handle fences[region_count];
+
+	GLboolean is_initialized;
+
+	std::size_t bytes_streamed;
+	unsigned int stalls_avoided;
+	unsigned int stalls;
+
+public:
+	StreamBuffer(std::size_t initial_region_size = 256 * 1024)
+		: mode(stream_client_memory), buffer(0), mapped(nullptr), region_size(initial_region_size),
+		region(0), region_offset(0), is_initialized(false), bytes_streamed(0), stalls_avoided(0), stalls(0) {
+
+		for (int i = 0; i < region_count; i++)
+			fences[i] = nullptr;
+	}
+
+	~StreamBuffer() {
+		release();
+	}
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// Fences the region written last frame and makes the next one writable
+	void begin_frame() {
+		if (!is_initialized)
+			initialize();
+
+		bytes_streamed = 0;
+		stalls_avoided = 0;
+		stalls = 0;
+
+		if (mode == stream_client_memory)
+			return;
+
+		if (mode == stream_orphaning) {
+			// The driver hands us fresh storage; the old one lives until the GPU is done
+			GLExtensions::bind_buffer(GL_ARRAY_BUFFER, buffer);
+			GLExtensions::buffer_data(GL_ARRAY_BUFFER, region_size, nullptr, GL_STREAM_DRAW);
+			GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+			region_offset = 0;
+			return;
+		}
+
+		if (region_offset > 0) {
+			fences[region] = GLExtensions::fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			region = (region + 1) % region_count;
+		}
+		region_offset = 0;
+
+		wait_for_region(region);
+	}
+
+	// Copies bytes into the stream and binds the buffer. The result is what
+	// gl*Pointer expects: an offset into the bound buffer, or a client pointer.
+	const GLubyte* write(const void* data, std::size_t bytes) {
+		if (!is_initialized)
+			initialize();
+
+		bytes_streamed += bytes;
+
+		if (mode == stream_client_memory)
+			return static_cast<const GLubyte*>(data);
+
+		if (region_offset + bytes > region_size)
+			grow(bytes);
+
+		std::size_t offset = region_offset;
+		if (mode != stream_orphaning)
+			offset += region * region_size;
+
+		GLExtensions::bind_buffer(GL_ARRAY_BUFFER, buffer);
+
+		switch (mode) {
+		case stream_persistent:
+			std::memcpy(mapped + offset, data, bytes);
+			break;
+		case stream_unsynchronized: {
+			void* destination = GLExtensions::map_buffer_range(GL_ARRAY_BUFFER, offset, bytes,
+				GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+			if (destination) {
+				std::memcpy(destination, data, bytes);
+				GLExtensions::unmap_buffer(GL_ARRAY_BUFFER);
+			}
+			break;
+		}
+		default:
+			GLExtensions::buffer_sub_data(GL_ARRAY_BUFFER, offset, bytes, data);
+			break;
+		}
+
+		// Keep following writes 16-byte aligned
+		region_offset += (bytes + 15) & ~static_cast<std::size_t>(15);
+
+		return reinterpret_cast<const GLubyte*>(offset);
+	}
+
+	void unbind() {
+		if (mode != stream_client_memory)
+			GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	stream_mode get_mode() const { return mode; }
+	std::size_t get_region_size() const { return region_size; }
+
+	std::size_t get_bytes_streamed() const { return bytes_streamed; }
+	// Regions whose fence had already signalled when we came back to them
+	unsigned int get_stalls_avoided() const { return stalls_avoided; }
+	unsigned int get_stalls() const { return stalls; }
+
+private:
+	void initialize() {
+		GLExtensions::load();
+
+		if (GLExtensions::has_buffer_storage())
+			mode = stream_persistent;
+		else if (GLExtensions::has_map_buffer_range() && GLExtensions::has_sync())
+			mode = stream_unsynchronized;
+		else if (GLExtensions::has_vertex_buffers())
+			mode = stream_orphaning;
+		else
+			mode = stream_client_memory;
+
+		create();
+		is_initialized = true;
+	}
+
+	void create() {
+		if (mode == stream_client_memory)
+			return;
+
+		GLExtensions::gen_buffers(1, &buffer);
+		GLExtensions::bind_buffer(GL_ARRAY_BUFFER, buffer);
+
+		std::size_t total = mode == stream_orphaning ? region_size : region_size * region_count;
+
+		if (mode == stream_persistent) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			GLExtensions::buffer_storage(GL_ARRAY_BUFFER, total, nullptr, flags);
+			mapped = static_cast<GLubyte*>(GLExtensions::map_buffer_range(GL_ARRAY_BUFFER, 0, total, flags));
+
+			if (!mapped) {
+				// Storage is immutable now, so start over with a plain buffer
+				GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+				GLExtensions::delete_buffers(1, &buffer);
+				mode = stream_unsynchronized;
+				create();
+				return;
+			}
+		}
+		else {
+			GLExtensions::buffer_data(GL_ARRAY_BUFFER, total, nullptr, GL_STREAM_DRAW);
+		}
+
+		GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+
+		region = 0;
+		region_offset = 0;
+	}
+
+	void release() {
+		for (int i = 0; i < region_count; i++) {
+			if (fences[i])
+				GLExtensions::delete_sync(fences[i]);
+			fences[i] = nullptr;
+		}
+
+		if (buffer) {
+			if (mapped) {
+				GLExtensions::bind_buffer(GL_ARRAY_BUFFER, buffer);
+				GLExtensions::unmap_buffer(GL_ARRAY_BUFFER);
+				GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+				mapped = nullptr;
+			}
+			GLExtensions::delete_buffers(1, &buffer);
+			buffer = 0;
+		}
+	}
+
+	// A region ran out of space: replace the whole buffer with a bigger one.
+	// Draws already issued keep the old buffer alive until they finish.
+	void grow(std::size_t bytes) {
+		// Sized for everything written this frame, so the next frame fits
+		std::size_t needed = region_offset + bytes;
+		if (region_size == 0)
+			region_size = 4096;
+		while (region_size < needed)
+			region_size *= 2;
+
+		release();
+		create();
+	}
+
+	void wait_for_region(int index) {
+		if (!fences[index])
+			return;
+
+		GLenum result = GLExtensions::client_wait_sync(fences[index], 0, 0);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+			stalls_avoided++;
+		}
+		else {
+			stalls++;
+			while (result == GL_TIMEOUT_EXPIRED)
+				result = GLExtensions::client_wait_sync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		}
+
+		GLExtensions::delete_sync(fences[index]);
+		fences[index] = nullptr;
+	}
+};
+
+const int StreamBuffer::region_count;
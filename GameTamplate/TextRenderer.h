@@ -0,0 +1,292 @@
+#pragma once
+#include "Sprite.h"
+#include "SpriteBatch.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Bitmap font text. The font is a prebuilt sheet of equally sized glyph
+// cells (16x16 ASCII grid by default) loaded through Sprite, so glyph UVs
+// come from the usual sprite sheet frame logic.
+//
+// Dynamic text goes through a SpriteBatch every frame. Labels that rarely
+// change are baked into one static buffer that is rebuilt only when a
+// label is added or edited, so a HUD costs one draw call for the labels
+// plus one for the batch.
+class TextRenderer {
+private:
+	struct glyph {
+		glm::vec2 cell;
+		unsigned int frame;
+	};
+
+	struct label {
+		std::string text;
+		glm::vec2 position;
+		GLfloat scale;
+		glm::vec4 color;
+		GLboolean is_visible;
+	};
+
+	Sprite* font;
+	glm::vec2 glyph_size;
+	unsigned int first_character;
+
+	static const std::size_t max_cached_layouts = 1024;
+
+	// Layouts in glyph cells, cached per string
+	std::unordered_map<std::string, std::vector<glyph>> layouts;
+
+	std::vector<label> labels;
+	std::vector<sprite_vertex> label_vertices;
+	GLuint label_buffer;
+	GLsizei label_vertex_count;
+	GLboolean are_labels_dirty;
+	GLboolean use_vertex_buffer;
+	GLboolean is_initialized;
+
+public:
+	// columns x rows glyph cells, the first cell holding first_character
+	TextRenderer(const char* font_file, const glm::vec2& glyph_size,
+		const glm::vec2& grid = glm::vec2(16, 16), unsigned int first_character = 0)
+		: glyph_size(glyph_size), first_character(first_character),
+		label_buffer(0), label_vertex_count(0), are_labels_dirty(false),
+		use_vertex_buffer(false), is_initialized(false) {
+
+		font = new Sprite(font_file, glyph_size, static_cast<GLuint>(grid.x * grid.y), grid, true);
+	}
+
+	~TextRenderer() {
+		if (label_buffer)
+			GLExtensions::delete_buffers(1, &label_buffer);
+		delete font;
+	}
+
+	TextRenderer(const TextRenderer&) = delete;
+	TextRenderer& operator=(const TextRenderer&) = delete;
+
+	// Dynamic text, e.g. an FPS counter. position is the bottom-left of the first line.
+	void draw(SpriteBatch& batch, const std::string& text, const glm::vec2& position,
+		GLfloat scale = 1.0f, const glm::vec4& color = glm::vec4(1.0f)) {
+
+		const std::vector<glyph>& layout = get_layout(text);
+
+		glm::vec2 corners[4];
+		glm::vec2 tex_coords[4];
+		const glm::vec2 no_flip(0.0f);
+		glm::vec2 size = glyph_size * scale;
+
+		for (const glyph& g : layout) {
+			get_glyph_corners(g, position, size, corners);
+			font->get_frame_tex_coords(g.frame, no_flip, tex_coords);
+			batch.draw(font->get_texture(), true, corners, tex_coords, color);
+		}
+	}
+
+	unsigned int add_label(const std::string& text, const glm::vec2& position,
+		GLfloat scale = 1.0f, const glm::vec4& color = glm::vec4(1.0f)) {
+
+		label l;
+		l.text = text;
+		l.position = position;
+		l.scale = scale;
+		l.color = color;
+		l.is_visible = true;
+		labels.push_back(l);
+
+		are_labels_dirty = true;
+		return static_cast<unsigned int>(labels.size() - 1);
+	}
+
+	void set_label_text(unsigned int id, const std::string& text) {
+		if (id < labels.size() && labels[id].text != text) {
+			labels[id].text = text;
+			are_labels_dirty = true;
+		}
+	}
+
+	void set_label_position(unsigned int id, const glm::vec2& position) {
+		if (id < labels.size() && labels[id].position != position) {
+			labels[id].position = position;
+			are_labels_dirty = true;
+		}
+	}
+
+	void set_label_is_visible(unsigned int id, const GLboolean is_visible) {
+		if (id < labels.size() && labels[id].is_visible != is_visible) {
+			labels[id].is_visible = is_visible;
+			are_labels_dirty = true;
+		}
+	}
+
+	void clear_labels() {
+		labels.clear();
+		are_labels_dirty = true;
+	}
+
+	// Draws every label with one glDrawArrays
+	void render_labels() {
+		if (!is_initialized) {
+			GLExtensions::load();
+			use_vertex_buffer = GLExtensions::has_vertex_buffers();
+			if (use_vertex_buffer)
+				GLExtensions::gen_buffers(1, &label_buffer);
+			is_initialized = true;
+		}
+
+		if (are_labels_dirty)
+			build_labels();
+
+		if (label_vertex_count == 0)
+			return;
+
+		const GLubyte* base = reinterpret_cast<const GLubyte*>(label_vertices.data());
+		if (use_vertex_buffer) {
+			GLExtensions::bind_buffer(GL_ARRAY_BUFFER, label_buffer);
+			base = nullptr;
+		}
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glVertexPointer(2, GL_FLOAT, sizeof(sprite_vertex), base + offsetof(sprite_vertex, x));
+		glTexCoordPointer(2, GL_FLOAT, sizeof(sprite_vertex), base + offsetof(sprite_vertex, u));
+		glColorPointer(4, GL_FLOAT, sizeof(sprite_vertex), base + offsetof(sprite_vertex, r));
+
+		GLState::enable(GL_TEXTURE_2D);
+		GLState::bind_texture(font->get_texture());
+		GLState::enable(GL_BLEND);
+		GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		glDrawArrays(GL_QUADS, 0, label_vertex_count);
+
+		GLState::disable(GL_BLEND);
+		GLState::disable(GL_TEXTURE_2D);
+		GLState::invalidate_color();
+
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+
+		if (use_vertex_buffer)
+			GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Size of the text block in world units
+	glm::vec2 measure(const std::string& text, GLfloat scale = 1.0f) {
+		unsigned int columns = 0;
+		unsigned int longest = 0;
+		unsigned int lines = text.empty() ? 0 : 1;
+
+		for (char c : text) {
+			if (c == '\n') {
+				lines++;
+				columns = 0;
+				continue;
+			}
+			columns++;
+			if (columns > longest)
+				longest = columns;
+		}
+
+		return glm::vec2(longest, lines) * glyph_size * scale;
+	}
+
+	void clear_layout_cache() { layouts.clear(); }
+
+	Sprite* get_font() const { return font; }
+	glm::vec2 get_glyph_size() const { return glyph_size; }
+	unsigned int get_label_count() const { return static_cast<unsigned int>(labels.size()); }
+
+private:
+	const std::vector<glyph>& get_layout(const std::string& text) {
+		auto found = layouts.find(text);
+		if (found != layouts.end())
+			return found->second;
+
+		// Text that changes every frame would otherwise grow the cache forever
+		if (layouts.size() >= max_cached_layouts)
+			layouts.clear();
+
+		std::vector<glyph>& layout = layouts[text];
+
+		glm::vec2 cell(0.0f);
+		unsigned int glyph_count = font->get_number_of_textures();
+
+		for (char c : text) {
+			unsigned char code = static_cast<unsigned char>(c);
+
+			if (code == '\n') {
+				cell.x = 0.0f;
+				cell.y -= 1.0f;
+				continue;
+			}
+
+			if (code != ' ' && code >= first_character && code - first_character < glyph_count) {
+				glyph g;
+				g.cell = cell;
+				g.frame = code - first_character;
+				layout.push_back(g);
+			}
+
+			cell.x += 1.0f;
+		}
+
+		return layout;
+	}
+
+	static void get_glyph_corners(const glyph& g, const glm::vec2& position, const glm::vec2& size, glm::vec2 corners[4]) {
+		glm::vec2 origin = position + g.cell * size;
+		corners[0] = origin;
+		corners[1] = origin + glm::vec2(size.x, 0.0f);
+		corners[2] = origin + size;
+		corners[3] = origin + glm::vec2(0.0f, size.y);
+	}
+
+	void build_labels() {
+		label_vertices.clear();
+
+		glm::vec2 corners[4];
+		glm::vec2 tex_coords[4];
+		const glm::vec2 no_flip(0.0f);
+
+		for (const label& l : labels) {
+			if (!l.is_visible)
+				continue;
+
+			glm::vec2 size = glyph_size * l.scale;
+
+			for (const glyph& g : get_layout(l.text)) {
+				get_glyph_corners(g, l.position, size, corners);
+				font->get_frame_tex_coords(g.frame, no_flip, tex_coords);
+
+				for (int i = 0; i < 4; i++) {
+					sprite_vertex vertex;
+					vertex.x = corners[i].x;
+					vertex.y = corners[i].y;
+					vertex.u = tex_coords[i].x;
+					vertex.v = tex_coords[i].y;
+					vertex.r = l.color.r;
+					vertex.g = l.color.g;
+					vertex.b = l.color.b;
+					vertex.a = l.color.a;
+					label_vertices.push_back(vertex);
+				}
+			}
+		}
+
+		label_vertex_count = static_cast<GLsizei>(label_vertices.size());
+
+		if (use_vertex_buffer) {
+			GLExtensions::bind_buffer(GL_ARRAY_BUFFER, label_buffer);
+			GLExtensions::buffer_data(GL_ARRAY_BUFFER, label_vertices.size() * sizeof(sprite_vertex),
+				label_vertices.empty() ? nullptr : label_vertices.data(), GL_STATIC_DRAW);
+			GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+		}
+
+		are_labels_dirty = false;
+	}
+};
+
+const std::size_t TextRenderer::max_cached_layouts;
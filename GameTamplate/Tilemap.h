@@ -0,0 +1,254 @@
+#pragma once
+#include "Sprite.h"
+#include "GLExtensions.h"
+#include "ViewCulling.h"
+
+#include <cstdint>
+#include <vector>
+
+// Grid of tiles drawn from the frames of one sprite sheet. Tiles are kept
+// in fixed-size chunks; each chunk builds its vertex buffer the first time
+// it is visible and again only after one of its tiles changed.
+class Tilemap {
+public:
+	static const std::uint16_t empty_tile = 0xFFFF;
+	static const int chunk_size = 32;
+
+private:
+	struct tile_vertex {
+		GLfloat x, y;
+		GLfloat u, v;
+	};
+
+	struct chunk {
+		std::vector<std::uint16_t> tiles;
+		std::vector<tile_vertex> vertices;
+		GLuint vertex_buffer;
+		GLsizei vertex_count;
+		GLboolean is_dirty;
+	};
+
+	Sprite* sprite;
+	glm::vec2 position;
+	glm::vec2 tile_size;
+
+	int width;
+	int height;
+	int chunks_x;
+	int chunks_y;
+	std::vector<chunk> chunks;
+
+	GLboolean use_vertex_buffers;
+	GLboolean is_initialized;
+
+	unsigned int chunks_drawn;
+	unsigned int chunks_rebuilt;
+
+public:
+	// width and height are in tiles; tile_size is in world units
+	Tilemap(Sprite* spr, int width, int height, const glm::vec2& tile_size, const glm::vec2& pos = glm::vec2(0.0f))
+		: sprite(spr), position(pos), tile_size(tile_size), width(width), height(height),
+		use_vertex_buffers(false), is_initialized(false), chunks_drawn(0), chunks_rebuilt(0) {
+
+		chunks_x = (width + chunk_size - 1) / chunk_size;
+		chunks_y = (height + chunk_size - 1) / chunk_size;
+
+		chunks.resize(chunks_x * chunks_y);
+		for (chunk& c : chunks) {
+			c.tiles.assign(chunk_size * chunk_size, empty_tile);
+			c.vertex_buffer = 0;
+			c.vertex_count = 0;
+			c.is_dirty = true;
+		}
+	}
+
+	~Tilemap() {
+		for (chunk& c : chunks) {
+			if (c.vertex_buffer)
+				GLExtensions::delete_buffers(1, &c.vertex_buffer);
+		}
+		delete sprite;
+	}
+
+	Tilemap(const Tilemap&) = delete;
+	Tilemap& operator=(const Tilemap&) = delete;
+
+	std::uint16_t get_tile(int x, int y) const {
+		if (x < 0 || y < 0 || x >= width || y >= height)
+			return empty_tile;
+
+		const chunk& c = chunks[(y / chunk_size) * chunks_x + x / chunk_size];
+		return c.tiles[(y % chunk_size) * chunk_size + x % chunk_size];
+	}
+
+	// tile is a frame index into the sprite sheet, or empty_tile
+	void set_tile(int x, int y, std::uint16_t tile) {
+		if (x < 0 || y < 0 || x >= width || y >= height)
+			return;
+
+		chunk& c = chunks[(y / chunk_size) * chunks_x + x / chunk_size];
+		std::uint16_t& current = c.tiles[(y % chunk_size) * chunk_size + x % chunk_size];
+		if (current != tile) {
+			current = tile;
+			c.is_dirty = true;
+		}
+	}
+
+	void fill(std::uint16_t tile) {
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				set_tile(x, y, tile);
+	}
+
+	void render() {
+		chunks_drawn = 0;
+		chunks_rebuilt = 0;
+
+		if (!sprite)
+			return;
+
+		if (!is_initialized) {
+			GLExtensions::load();
+			use_vertex_buffers = GLExtensions::has_vertex_buffers();
+			is_initialized = true;
+		}
+
+		// Chunk range overlapping the view, computed directly instead of testing every chunk
+		glm::vec2 chunk_extent = tile_size * static_cast<float>(chunk_size);
+		glm::vec2 view_min = (ViewCulling::get_view_min() - position) / chunk_extent;
+		glm::vec2 view_max = (ViewCulling::get_view_max() - position) / chunk_extent;
+
+		int first_x = glm::max(0, static_cast<int>(floor(view_min.x)));
+		int first_y = glm::max(0, static_cast<int>(floor(view_min.y)));
+		int last_x = glm::min(chunks_x - 1, static_cast<int>(floor(view_max.x)));
+		int last_y = glm::min(chunks_y - 1, static_cast<int>(floor(view_max.y)));
+
+		if (!ViewCulling::get_is_enabled()) {
+			first_x = 0;
+			first_y = 0;
+			last_x = chunks_x - 1;
+			last_y = chunks_y - 1;
+		}
+
+		if (first_x > last_x || first_y > last_y)
+			return;
+
+		GLState::enable(GL_TEXTURE_2D);
+		GLState::bind_texture(sprite->get_texture());
+		GLState::set_color(1.0f, 1.0f, 1.0f, 1.0f);
+		if (sprite->get_is_transparent()) {
+			GLState::enable(GL_BLEND);
+			GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+		for (int cy = first_y; cy <= last_y; cy++) {
+			for (int cx = first_x; cx <= last_x; cx++) {
+				chunk& c = chunks[cy * chunks_x + cx];
+
+				if (c.is_dirty)
+					build_chunk(c, cx, cy);
+
+				if (c.vertex_count == 0)
+					continue;
+
+				const GLubyte* base = reinterpret_cast<const GLubyte*>(c.vertices.data());
+				if (use_vertex_buffers) {
+					GLExtensions::bind_buffer(GL_ARRAY_BUFFER, c.vertex_buffer);
+					base = nullptr;
+				}
+
+				glVertexPointer(2, GL_FLOAT, sizeof(tile_vertex), base + offsetof(tile_vertex, x));
+				glTexCoordPointer(2, GL_FLOAT, sizeof(tile_vertex), base + offsetof(tile_vertex, u));
+				glDrawArrays(GL_QUADS, 0, c.vertex_count);
+
+				chunks_drawn++;
+			}
+		}
+
+		if (use_vertex_buffers)
+			GLExtensions::bind_buffer(GL_ARRAY_BUFFER, 0);
+
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+
+		if (sprite->get_is_transparent())
+			GLState::disable(GL_BLEND);
+		GLState::disable(GL_TEXTURE_2D);
+	}
+
+	Sprite* get_sprite() const { return sprite; }
+
+	glm::vec2 get_position() const { return position; }
+	void set_position(const glm::vec2& new_position) { position = new_position; mark_all_dirty(); }
+
+	glm::vec2 get_tile_size() const { return tile_size; }
+
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+
+	unsigned int get_chunks_drawn() const { return chunks_drawn; }
+	unsigned int get_chunks_rebuilt() const { return chunks_rebuilt; }
+
+private:
+	void mark_all_dirty() {
+		for (chunk& c : chunks)
+			c.is_dirty = true;
+	}
+
+	void build_chunk(chunk& c, int cx, int cy) {
+		c.vertices.clear();
+
+		glm::vec2 tex_coords[4];
+		const glm::vec2 no_flip(0.0f);
+
+		for (int ty = 0; ty < chunk_size; ty++) {
+			for (int tx = 0; tx < chunk_size; tx++) {
+				std::uint16_t tile = c.tiles[ty * chunk_size + tx];
+				if (tile == empty_tile)
+					continue;
+
+				sprite->get_frame_tex_coords(tile, no_flip, tex_coords);
+
+				glm::vec2 origin = position + glm::vec2(cx * chunk_size + tx, cy * chunk_size + ty) * tile_size;
+				const glm::vec2 corners[4] = {
+					origin,
+					origin + glm::vec2(tile_size.x, 0.0f),
+					origin + tile_size,
+					origin + glm::vec2(0.0f, tile_size.y)
+				};
+
+				for (int i = 0; i < 4; i++) {
+					tile_vertex vertex;
+					vertex.x = corners[i].x;
+					vertex.y = corners[i].y;
+					vertex.u = tex_coords[i].x;
+					vertex.v = tex_coords[i].y;
+					c.vertices.push_back(vertex);
+				}
+			}
+		}
+
+		c.vertex_count = static_cast<GLsizei>(c.vertices.size());
+
+		if (use_vertex_buffers) {
+			if (!c.vertex_buffer)
+				GLExtensions::gen_buffers(1, &c.vertex_buffer);
+
+			GLExtensions::bind_buffer(GL_ARRAY_BUFFER, c.vertex_buffer);
+			GLExtensions::buffer_data(GL_ARRAY_BUFFER, c.vertices.size() * sizeof(tile_vertex),
+				c.vertices.empty() ? nullptr : c.vertices.data(), GL_STATIC_DRAW);
+
+			// The GPU copy is all that is needed from now on
+			std::vector<tile_vertex>().swap(c.vertices);
+		}
+
+		c.is_dirty = false;
+		chunks_rebuilt++;
+	}
+};
+
+const std::uint16_t Tilemap::empty_tile;
+const int Tilemap::chunk_size;
@@ -0,0 +1,34 @@
+#pragma once
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include <glm.hpp>
+#include <gtx/matrix_transform_2d.hpp>
+
+// 2D affine transforms as 3x3 matrices, column-major like the rest of GLM:
+// columns 0 and 1 are the transformed x and y axes, column 2 the origin.
+class Transform2D {
+public:
+	// Translate, then rotate (degrees, like glRotatef), then scale, the
+	// order GameObject::render used to build on the matrix stack
+	static glm::mat3 make(const glm::vec2& position, float rotation, const glm::vec2& scale) {
+		glm::mat3 m = glm::translate(glm::mat3(1.0f), position);
+		m = glm::rotate(m, glm::radians(rotation));
+		return glm::scale(m, scale);
+	}
+
+	static glm::vec2 apply(const glm::mat3& m, const glm::vec2& point) {
+		return glm::vec2(m[0]) * point.x + glm::vec2(m[1]) * point.y + glm::vec2(m[2]);
+	}
+
+	// Box around [local_min, local_max] once transformed
+	static void bounds(const glm::mat3& m, const glm::vec2& local_min, const glm::vec2& local_max,
+		glm::vec2& min, glm::vec2& max) {
+
+		glm::vec2 center = apply(m, (local_min + local_max) * 0.5f);
+		glm::vec2 half = (local_max - local_min) * 0.5f;
+		glm::vec2 extent = glm::abs(glm::vec2(m[0])) * half.x + glm::abs(glm::vec2(m[1])) * half.y;
+		min = center - extent;
+		max = center + extent;
+	}
+};
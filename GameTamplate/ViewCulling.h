@@ -0,0 +1,69 @@
+#pragma once
+#include <glm.hpp>
+
+// Visible rectangle in world units, kept in sync with the gluOrtho2D
+// projection set up in reshape(). GameObjects test their bounds against it
+// before issuing any GL call.
+class ViewCulling {
+private:
+	static glm::vec2 view_min;
+	static glm::vec2 view_max;
+	static bool is_enabled;
+
+	static unsigned int objects_tested;
+	static unsigned int objects_culled;
+
+public:
+	static void set_view(const glm::vec2& min, const glm::vec2& max) {
+		view_min = min;
+		view_max = max;
+	}
+
+	static glm::vec2 get_view_min() { return view_min; }
+	static glm::vec2 get_view_max() { return view_max; }
+
+	static bool get_is_enabled() { return is_enabled; }
+	static void set_is_enabled(bool enabled) { is_enabled = enabled; }
+
+	// Counts the test, so call it once per object per frame
+	static bool test(const glm::vec2& min, const glm::vec2& max) {
+		if (!is_enabled)
+			return true;
+
+		objects_tested++;
+
+		if (!overlaps(min, max)) {
+			objects_culled++;
+			return false;
+		}
+
+		return true;
+	}
+
+	// Same test without touching the counters, safe to call from any thread
+	static bool overlaps(const glm::vec2& min, const glm::vec2& max) {
+		return !(max.x < view_min.x || min.x > view_max.x || max.y < view_min.y || min.y > view_max.y);
+	}
+
+	// For callers that counted on their own with overlaps()
+	static void add_results(unsigned int tested, unsigned int culled) {
+		objects_tested += tested;
+		objects_culled += culled;
+	}
+
+	static void begin_frame() {
+		objects_tested = 0;
+		objects_culled = 0;
+	}
+
+	static unsigned int get_objects_tested() { return objects_tested; }
+	static unsigned int get_objects_culled() { return objects_culled; }
+	static unsigned int get_objects_drawn() { return objects_tested - objects_culled; }
+};
+
+glm::vec2 ViewCulling::view_min = glm::vec2(0.0f);
+glm::vec2 ViewCulling::view_max = glm::vec2(0.0f);
+bool ViewCulling::is_enabled = true;
+
+unsigned int ViewCulling::objects_tested = 0;
+unsigned int ViewCulling::objects_culled = 0;